@@ -0,0 +1,388 @@
+/*
+pvrinput-bench: feeds program streams through the remuxer of the read thread
+and measures its throughput. Built with 'make bench', doesn't need vdr or a
+card:
+
+  pvrinput-bench [options] [file.mpg ...]
+
+Without files a synthetic stream is generated (-s). Each TS packet is checked
+(size, sync byte, continuity counter), the checksum of the output is printed
+and compared with -c, so changes of the remuxer can be verified on any box.
+*/
+#include "standalone.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+int PvrStandaloneLogLevel = pvrERROR;
+
+void log(int level, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "pvrinput-bench: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
+// count the allocations made while remuxing
+extern "C" void *__libc_malloc(size_t Size);
+extern "C" void *__libc_calloc(size_t Count, size_t Size);
+extern "C" void *__libc_realloc(void *Ptr, size_t Size);
+static long allocations = 0;
+
+extern "C" void *malloc(size_t Size)
+{
+  allocations++;
+  return __libc_malloc(Size);
+}
+
+extern "C" void *calloc(size_t Count, size_t Size)
+{
+  allocations++;
+  return __libc_calloc(Count, Size);
+}
+
+extern "C" void *realloc(void *Ptr, size_t Size)
+{
+  allocations++;
+  return __libc_realloc(Ptr, Size);
+}
+
+// --- the sink: checks and hashes what the remuxer delivers ---------------
+
+class cBenchRemux : public cPvrRemux {
+private:
+  int cc[0x2000];       // last continuity counter per PID, -1 = none
+  void ResetCounters(void) { for (int i = 0; i < 0x2000; i++) cc[i] = -1; }
+protected:
+  virtual void PutTs(const uint8_t *Data, int Count);
+public:
+  uint64_t checksum;
+  long packets;
+  long errors;
+  cBenchRemux(void) { Start(); }
+  void Start(void) { ResetCounters(); checksum = 0xCBF29CE484222325ull; packets = errors = 0; }
+};
+
+void cBenchRemux::PutTs(const uint8_t *Data, int Count)
+{
+  if ((Count != TS_SIZE) || (Data[0] != TS_SYNC_BYTE)) {
+     if (!errors++)
+        log(pvrERROR, "packet %ld: size %d, sync byte 0x%02x", packets, Count, Data[0]);
+     return;
+     }
+  int pid = ((Data[1] & 0x1F) << 8) | Data[2];
+  int counter = Data[3] & 0x0F;
+  if ((cc[pid] >= 0) && (counter != ((cc[pid] + 1) & 0x0F))) {
+     if (!errors++)
+        log(pvrERROR, "packet %ld: PID %d continuity counter %d after %d", packets, pid, counter, cc[pid]);
+     }
+  cc[pid] = counter;
+  for (int i = 0; i < TS_SIZE; i++) // FNV-1a
+      checksum = (checksum ^ Data[i]) * 0x100000001B3ull;
+  packets++;
+}
+
+// --- synthetic program streams --------------------------------------------
+
+enum eStreamKind { kTV, kVBI, kDVD, kRadio };
+
+class cStreamGenerator {
+private:
+  uint8_t *data;
+  size_t length;
+  size_t size;
+  uint64_t scr;
+  uint32_t seed;
+  int Random(void) { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7FFF; }
+  void Put(uint8_t b) { data[length++] = b; }
+  void PackHeader(void);
+  void PesHeader(uint8_t StreamId, int PayloadLength, uint64_t Pts);
+  void Payload(int Length);
+  void Vbi(bool Dynamic);
+  void Padding(int Length);
+public:
+  cStreamGenerator(size_t Size);
+  ~cStreamGenerator() { free(data); }
+  void Generate(eStreamKind Kind);
+  const uint8_t *Data(void) { return data; }
+  size_t Length(void) { return length; }
+};
+
+cStreamGenerator::cStreamGenerator(size_t Size)
+: length(0),
+  size(Size),
+  scr(90000),
+  seed(1)
+{
+  data = (uint8_t *)malloc(size + 4096);
+}
+
+void cStreamGenerator::PackHeader(void)
+{
+  Put(0x00); Put(0x00); Put(0x01); Put(0xBA);
+  Put(0x44 | ((scr >> 27) & 0x38) | ((scr >> 28) & 0x03));
+  Put((scr >> 20) & 0xFF);
+  Put(((scr >> 12) & 0xF8) | 0x04 | ((scr >> 13) & 0x03));
+  Put((scr >> 5) & 0xFF);
+  Put(((scr << 3) & 0xF8) | 0x04);
+  Put(0x01);
+  Put(0x89); Put(0xC3); Put(0xF8); // mux rate, no stuffing
+  Put(0xF8);
+}
+
+void cStreamGenerator::PesHeader(uint8_t StreamId, int PayloadLength, uint64_t Pts)
+{
+  int pes_length = 3 + 5 + PayloadLength;
+  Put(0x00); Put(0x00); Put(0x01); Put(StreamId);
+  Put(pes_length >> 8); Put(pes_length & 0xFF);
+  Put(0x81); Put(0x80); Put(0x05);
+  Put(0x21 | ((Pts >> 29) & 0x0E));
+  Put((Pts >> 22) & 0xFF);
+  Put(((Pts >> 14) & 0xFE) | 0x01);
+  Put((Pts >> 7) & 0xFF);
+  Put(((Pts << 1) & 0xFE) | 0x01);
+}
+
+void cStreamGenerator::Payload(int Length)
+{
+  for (int i = 0; i < Length; i++) {
+      uint8_t b = Random();
+      // no start codes inside the payload
+      if ((i >= 2) && (b == 0x01) && (data[length - 1] == 0x00) && (data[length - 2] == 0x00))
+         b = 0x02;
+      Put(b);
+      }
+}
+
+/*
+sliced VBI as ivtv delivers it: teletext, WSS and VPS lines
+*/
+void cStreamGenerator::Vbi(bool Dynamic)
+{
+  v4l2_mpeg_vbi_fmt_ivtv vbi;
+  memset(&vbi, 0, sizeof(vbi));
+  int vbiLength;
+  if (Dynamic) {
+     memcpy(vbi.magic, "itv0", 4);
+     uint32_t mask = 0;
+     int n = 0;
+     for (int line = 1; line < 17; line++) {
+         if ((line != 10) && (line != 17)) {
+            mask |= 1 << line;
+            vbi.itv0.line[n].id = V4L2_MPEG_VBI_IVTV_TELETEXT_B;
+            for (int i = 0; i < 42; i++)
+                vbi.itv0.line[n].data[i] = Random();
+            n++;
+            }
+         }
+     vbi.itv0.linemask[0] = mask;
+     vbiLength = 4 + 8 + n * sizeof(v4l2_mpeg_vbi_itv0_line);
+     }
+  else {
+     memcpy(vbi.magic, "ITV0", 4);
+     for (int line = 1; line < 17; line++) {
+         vbi.ITV0.line[line].id = V4L2_MPEG_VBI_IVTV_TELETEXT_B;
+         for (int i = 0; i < 42; i++)
+             vbi.ITV0.line[line].data[i] = Random();
+         }
+     vbi.ITV0.line[10].id = V4L2_MPEG_VBI_IVTV_VPS;
+     vbi.ITV0.line[17].id = V4L2_MPEG_VBI_IVTV_WSS_625;
+     vbiLength = 4 + sizeof(vbi.ITV0);
+     }
+  PesHeader(0xBD, vbiLength, scr);
+  memcpy(data + length, &vbi, vbiLength);
+  length += vbiLength;
+}
+
+void cStreamGenerator::Padding(int Length)
+{
+  if (Length < 6)
+     return;
+  Put(0x00); Put(0x00); Put(0x01); Put(0xBE);
+  Put((Length - 6) >> 8); Put((Length - 6) & 0xFF);
+  for (int i = 6; i < Length; i++)
+      Put(0xFF);
+}
+
+void cStreamGenerator::Generate(eStreamKind Kind)
+{
+  int frame = 0;
+  while (length + 2048 * 16 < size) {
+    uint64_t pts = scr + 45000;
+    if (Kind == kDVD) {
+       // 2048 byte packs as with V4L2_MPEG_STREAM_TYPE_MPEG2_DVD
+       for (int i = 0; i < 12; i++) {
+           size_t start = length;
+           PackHeader();
+           if (i == 0)
+              PesHeader(0xC0, 576, pts);
+           else
+              PesHeader(0xE0, 2048 - 14 - 14 - 100, pts);
+           Payload(i == 0 ? 576 : 2048 - 14 - 14 - 100);
+           Padding(2048 - (length - start));
+           scr += 300;
+           }
+       }
+    else {
+       PackHeader();
+       if (Kind != kRadio) {
+          int size = 4000 + Random() % 8000;
+          PesHeader(0xE0, size, pts);
+          Payload(size);
+          }
+       PesHeader(0xC0, 576, pts);
+       Payload(576);
+       if ((Kind == kVBI) && !(frame % 2))
+          Vbi(frame % 4 == 0);
+       scr += 3600;
+       }
+    frame++;
+    }
+}
+
+// --- main -----------------------------------------------------------------
+
+static bool ReadFile(const char *FileName, uint8_t *&Data, size_t &Length)
+{
+  FILE *f = fopen(FileName, "rb");
+  if (!f) {
+     fprintf(stderr, "pvrinput-bench: %s: %s\n", FileName, strerror(errno));
+     return false;
+     }
+  fseek(f, 0, SEEK_END);
+  Length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  Data = (uint8_t *)malloc(Length ? Length : 1);
+  bool ok = fread(Data, 1, Length, f) == Length;
+  fclose(f);
+  return ok;
+}
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+remuxes Data Loops times in reads of ReadSize bytes, returns false on errors
+*/
+static bool Run(const char *Name, const uint8_t *Data, size_t Length, int ReadSize, int Loops, bool Radio, bool Teletext, const char *Expected)
+{
+  cBenchRemux *remux = new cBenchRemux;
+  uint64_t checksum = 0;
+  long packets = 0;
+  bool ok = true;
+  long allocs = allocations;
+  double start = Now();
+  for (int loop = 0; loop < Loops; loop++) {
+      remux->Start();
+      remux->Reset(1, 1, Radio, Teletext);
+      for (size_t pos = 0; pos < Length; pos += ReadSize)
+          remux->ParseProgramStream(Data + pos, (Length - pos < (size_t)ReadSize) ? Length - pos : ReadSize);
+      if (loop == 0)
+         checksum = remux->checksum;
+      else if (remux->checksum != checksum) {
+         fprintf(stderr, "pvrinput-bench: %s: checksum of pass %d differs\n", Name, loop + 1);
+         ok = false;
+         }
+      if (remux->errors)
+         ok = false;
+      packets += remux->packets;
+      }
+  double elapsed = Now() - start;
+  allocs = allocations - allocs;
+  double bytes = (double)Length * Loops;
+  printf("%-16s %8.1f MB/s %10.0f packets/s %7.1f ns/packet %6ld allocs  %016llx%s\n",
+         Name, bytes / elapsed / 1e6, packets / elapsed, packets ? elapsed * 1e9 / packets : 0.0,
+         allocs, (unsigned long long)checksum, ok ? "" : "  ERRORS");
+  if (Expected && (strtoull(Expected, NULL, 16) != checksum)) {
+     fprintf(stderr, "pvrinput-bench: %s: checksum %016llx, expected %s\n", Name, (unsigned long long)checksum, Expected);
+     ok = false;
+     }
+  delete remux;
+  return ok;
+}
+
+static void Usage(void)
+{
+  fprintf(stderr,
+    "usage: pvrinput-bench [options] [file ...]\n"
+    "  -s tv|vbi|dvd|radio|all  synthetic stream (default all, if no files are given)\n"
+    "  -m MB                    size of the synthetic stream (default 64)\n"
+    "  -b KB                    size of a read (default 256, like ReadBufferSizeKB)\n"
+    "  -n loops                 remux each stream n times (default 5)\n"
+    "  -r                       files are radio streams\n"
+    "  -t                       announce teletext in the PMT\n"
+    "  -c checksum              expected checksum (hex) of the (first) stream\n"
+    "  -v                       log the messages of the remuxer\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *synthetic = NULL;
+  const char *expected = NULL;
+  int megabytes = 64;
+  int readSize = 256 * 1024;
+  int loops = 5;
+  bool radio = false;
+  bool teletext = false;
+  int c;
+  while ((c = getopt(argc, argv, "s:m:b:n:rtc:vh")) != -1) {
+    switch (c) {
+      case 's': synthetic = optarg; break;
+      case 'm': megabytes = atoi(optarg); break;
+      case 'b': readSize = atoi(optarg) * 1024; break;
+      case 'n': loops = atoi(optarg); break;
+      case 'r': radio = true; break;
+      case 't': teletext = true; break;
+      case 'c': expected = optarg; break;
+      case 'v': PvrStandaloneLogLevel = pvrDEBUG3; break;
+      default:  Usage(); return 2;
+      }
+    }
+  if ((megabytes <= 0) || (readSize <= 0) || (loops <= 0)) {
+     Usage();
+     return 2;
+     }
+  if (!synthetic && (optind >= argc))
+     synthetic = "all";
+  bool ok = true;
+  if (synthetic) {
+     static const struct { const char *name; eStreamKind kind; } kinds[] = {
+       { "tv", kTV }, { "vbi", kVBI }, { "dvd", kDVD }, { "radio", kRadio } };
+     bool found = false;
+     for (unsigned i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+         if (strcmp(synthetic, "all") && strcmp(synthetic, kinds[i].name))
+            continue;
+         found = true;
+         cStreamGenerator gen((size_t)megabytes * 1024 * 1024);
+         gen.Generate(kinds[i].kind);
+         ok &= Run(kinds[i].name, gen.Data(), gen.Length(), readSize, loops, kinds[i].kind == kRadio, kinds[i].kind == kVBI, expected);
+         expected = NULL;
+         }
+     if (!found) {
+        Usage();
+        return 2;
+        }
+     }
+  for (int i = optind; i < argc; i++) {
+      uint8_t *data;
+      size_t length;
+      if (!ReadFile(argv[i], data, length)) {
+         ok = false;
+         continue;
+         }
+      const char *name = strrchr(argv[i], '/');
+      ok &= Run(name ? name + 1 : argv[i], data, length, readSize, loops, radio, teletext, expected);
+      expected = NULL;
+      free(data);
+      }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include "common.h"
+
+cPvrBufferPool PvrReadBuffers;
+
+cPvrBufferPool::cPvrBufferPool(void)
+: numFree(0),
+  allocated(0),
+  lastGet(0)
+{
+}
+
+cPvrBufferPool::~cPvrBufferPool()
+{
+  FreeAll();
+}
+
+void cPvrBufferPool::FreeAll(void)
+{
+  while (numFree > 0) {
+    numFree--;
+    allocated -= freeSize[numFree];
+    delete [] freeBuffer[numFree];
+    }
+}
+
+uint8_t *cPvrBufferPool::Get(int Size)
+{
+  cMutexLock lock(&mutex);
+  lastGet = time(NULL);
+  for (int i = 0; i < numFree; i++) {
+      if (freeSize[i] == Size) {
+         uint8_t *buffer = freeBuffer[i];
+         numFree--;
+         freeBuffer[i] = freeBuffer[numFree];
+         freeSize[i] = freeSize[numFree];
+         return buffer;
+         }
+      }
+  allocated += Size;
+  return new uint8_t[Size];
+}
+
+void cPvrBufferPool::Put(uint8_t *Buffer, int Size)
+{
+  cMutexLock lock(&mutex);
+  if (numFree < kMaxFree) {
+     freeBuffer[numFree] = Buffer;
+     freeSize[numFree] = Size;
+     numFree++;
+     return;
+     }
+  allocated -= Size;
+  delete [] Buffer;
+}
+
+void cPvrBufferPool::Trim(int IdleSeconds)
+{
+  cMutexLock lock(&mutex);
+  if (!numFree || (time(NULL) - lastGet < IdleSeconds))
+     return;
+  FreeAll();
+  log(pvrDEBUG1, "cPvrBufferPool: released unused read buffers, %d KB left", allocated / 1024);
+}
+
+int cPvrBufferPool::Allocated(void)
+{
+  cMutexLock lock(&mutex);
+  return allocated;
+}
@@ -0,0 +1,31 @@
+#ifndef _PVRINPUT_BUFFERPOOL_H_
+#define _PVRINPUT_BUFFERPOOL_H_
+
+/*
+Read buffers of the read threads. A stopping reader gives its buffer back and
+the next one (of any device) takes it again, so channel switches don't
+allocate. Up to kMaxFree unused buffers are kept, Trim() frees them once
+they weren't asked for during IdleSeconds.
+*/
+class cPvrBufferPool {
+private:
+  enum { kMaxFree = 2 };
+  cMutex mutex;
+  uint8_t *freeBuffer[kMaxFree];
+  int freeSize[kMaxFree];
+  int numFree;
+  int allocated; // bytes of all buffers, used or free
+  time_t lastGet;
+  void FreeAll(void);
+public:
+  cPvrBufferPool(void);
+  ~cPvrBufferPool();
+  uint8_t *Get(int Size);
+  void Put(uint8_t *Buffer, int Size);
+  void Trim(int IdleSeconds);
+  int Allocated(void);
+};
+
+extern cPvrBufferPool PvrReadBuffers;
+
+#endif
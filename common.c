@@ -2,33 +2,14 @@
 
 void log(int level, const char *fmt, ...)
 {
-  char tmpstr[BUFSIZ];
-  char timestr[16];
-  va_list ap;
-  time_t now;
-  struct tm local;
-
   if (PvrSetup.LogLevel >= level) {
+     va_list ap;
      va_start(ap, fmt);
-     time(&now);
-     localtime_r(&now, &local);
-     vsnprintf(tmpstr, sizeof(tmpstr), fmt, ap);
-     strftime(timestr, sizeof(timestr), "%H:%M:%S", &local);
-     printf("pvrinput: %s %s\n", timestr, tmpstr);
-     switch (level) {
-       case pvrERROR:
-              esyslog("%s",tmpstr);
-              break;
-       case pvrINFO:
-              isyslog("%s",tmpstr);
-              break;
-       case pvrDEBUG1:
-       case pvrDEBUG2:
-       case pvrDEBUG3:
-       default:
-              dsyslog("%s",tmpstr);
-              break;
-       }
+     if (!PvrLogger.Queue(level, fmt, ap)) {
+        char tmpstr[BUFSIZ];
+        vsnprintf(tmpstr, sizeof(tmpstr), fmt, ap);
+        cPvrLogger::Output(level, time(NULL), tmpstr);
+        }
      va_end(ap);
      }
 }
@@ -44,19 +25,33 @@ int IOCTL(int fd, int cmd, void *data)
      log(pvrERROR, "Error IOCTL: %s is not open", fd);
      return -1;
      }
+#ifdef PVR_USDT
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+#define IOCTL_PROBE(result) \
+  clock_gettime(CLOCK_MONOTONIC, &end); \
+  PVR_PROBE5(ioctl, fd, cmd, result, (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000, 5 - retry)
+#else
+#define IOCTL_PROBE(result)
+#endif
   for (int retry = 5; retry >= 0; ) {
       if (ioctl(fd, cmd, data) != 0) {
          if (retry) {
+            cPvrDevice::IoctlRetried(fd);
             usleep(20000); /* 20msec */
             retry--;
             continue;
             }
+         IOCTL_PROBE(-1);
          return -1;
          }
-      else
+      else {
+         IOCTL_PROBE(0);
          return 0;  /* all went okay :) */
+         }
       }
   return 0;  /* should never reach this */
+#undef IOCTL_PROBE
 }
 
 /*
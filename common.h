@@ -5,6 +5,7 @@ enum eLogLevel { pvrUNUSED, pvrERROR, pvrINFO, pvrDEBUG1, pvrDEBUG2, pvrDEBUG3 }
 
 #include <linux/videodev2.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <stdarg.h>
 
 #include <vdr/device.h>
@@ -14,15 +15,29 @@ enum eLogLevel { pvrUNUSED, pvrERROR, pvrINFO, pvrDEBUG1, pvrDEBUG2, pvrDEBUG3 }
 #define PVR_SOURCEPARAMS
 #endif
 
+#include "probes.h"
 #include "setup.h"
+#include "logger.h"
 #include "filter.h"
+#include "profile.h"
+#include "remux.h"
+#include "gop.h"
+#include "drift.h"
+#include "quality.h"
+#include "stats.h"
 #include "device.h"
 #include "global.h"
+#include "governor.h"
+#include "bufferpool.h"
+#include "pipeline.h"
 #include "reader.h"
+#include "tuner.h"
+#include "externhelper.h"
 #include "pvrinput.h"
 #include "menu.h"
 #include "submenu.h"
 #include "sourceparams.h"
+#include "metrics.h"
 
 #if VDRVERSNUM < 10507
 #include "i18n.h"
@@ -31,6 +46,13 @@ enum eLogLevel { pvrUNUSED, pvrERROR, pvrINFO, pvrDEBUG1, pvrDEBUG2, pvrDEBUG3 }
 
 void log(int level, const char *fmt, ...);
 
+/* for hot paths (reader, GetTSPacket): checks the level before calling log()
+   and drops everything above PVR_MAX_LOGLEVEL at compile time */
+#ifndef PVR_MAX_LOGLEVEL
+#define PVR_MAX_LOGLEVEL pvrDEBUG3
+#endif
+#define dlog(level, ...) do { if (((level) <= PVR_MAX_LOGLEVEL) && (PvrSetup.LogLevel >= (level))) log(level, __VA_ARGS__); } while (0)
+
 int IOCTL(int fd, int cmd, void *data);
 
 int Percent2IntVal(int Percent, int MinVal, int MaxVal);
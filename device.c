@@ -3,16 +3,17 @@
 #include <linux/dvb/video.h>
 
 char DRIVERNAME[][15] = {
-  "undef", "ivtv", "cx18", "pvrusb2", "cx88_blackbird", "hdpvr"
+  "undef", "ivtv", "cx18", "pvrusb2", "cx88_blackbird", "hdpvr", "file"
 };
 
 char CARDNAME[][9] = {
   "undef", "PVR150", "PVR250", "PVR350", "PVR500#1", "PVR500#2", "HVR1300", "HVR1600", "HVR1900", "HVR1950", "PVRUSB2", "HDPVR"
 };
 
-cPvrDevice *PvrDevices[kMaxPvrDevices];
+cPvrDevice *PvrDevices[kMaxDevices];
 
 cString cPvrDevice::externChannelSwitchScript;
+cString cPvrDevice::externChannelSwitchHelper;
 int     cPvrDevice::VBIDeviceCount = 0;
 
 cPvrDevice::cPvrDevice(int DeviceNumber, cDevice *ParentDevice)
@@ -37,13 +38,94 @@ cPvrDevice::cPvrDevice(int DeviceNumber, cDevice *ParentDevice)
   pvrusb2_ready(true),
   driver(undef),
   cardname(UNDEF),
+  tsBuffer(NULL),
+  tsBufferSize(0),
+  tsBufferInUse(false),
+  tsBufferIdleSince(0),
+  readBufferSize(0),
   tsBufferPrefill(0),
-  readThread(0)
+  readThread(0),
+  tuneThread(0),
+  externHelper(0),
+  tuneState(eTuneIdle),
+  tuneGeneration(0),
+  signalStrength(-1),
+  signalLastRequest(0),
+  signalNextSample(0),
+  signalForce(false),
+  signalSampling(false),
+  fdChanges(0),
+  reInitPending(false),
+  setupDeferred(false),
+  liveView(false),
+  drift(this),
+  watchdogIncidents(0),
+  watchdogRecoveries(0),
+  watchdogLastMs(-1),
+  recoveryRequest(0),
+  recovering(false),
+  captureFailed(false),
+  profileLive(false),
+  bitrateLevel(0),
+  bitrateLevelWanted(0),
+  zapStart(0),
+  lastZapMs(-1),
+  ioctlRetries(0),
+  fileIsFifo(false),
+  lingering(false),
+  lingerStopping(false),
+  lingerUntil(0),
+  discardOutput(false),
+  gopAlign(false),
+  preTuned(false),
+  preTuneRequested(false),
+  preTunePending(false)
 {
   log(pvrDEBUG2, "new cPvrDevice (%d)", number);
   v4l2_fd = mpeg_fd = radio_fd = -1;
   v4l2_dev = mpeg_dev = -1;
   vpid = apid = tpid = -1;
+  if (number >= kFirstFileDevice)
+    InitFileDevice();
+  else
+    InitVideoDevice();
+  ResetBuffering();
+  ReInit();
+  tuneThread = new cPvrTuneThread(this);
+  StartSectionHandler();
+  index = 0;
+  while ((index < kMaxDevices) && (PvrDevices[index] != NULL))
+    index++;
+  if (index < kMaxDevices)
+     PvrDevices[index] = this;
+  else {
+     index = -1;
+     esyslog("ERROR: too many cPvrDevices!");
+     }
+}
+
+cPvrDevice::~cPvrDevice()
+{
+  if ((index >= 0) && (index < kMaxDevices) && (PvrDevices[index] == this))
+     PvrDevices[index] = NULL;
+#if VDRVERSNUM >= 10600
+  StopSectionHandler();
+#endif
+  DetachAllReceivers();
+  Stop();
+  cRingBufferLinear *tsBuffer_tmp = tsBuffer;
+  log(pvrDEBUG2, "~cPvrDevice()");
+  tsBuffer = NULL;
+  delete tsBuffer_tmp;
+  close(radio_fd);
+  close(v4l2_fd);
+}
+
+/*
+everything of the constructor which needs the card
+*/
+void cPvrDevice::InitVideoDevice(void)
+{
   cString devName;
   struct v4l2_capability video_vcap;
   struct v4l2_capability capability;
@@ -158,6 +240,8 @@ cPvrDevice::cPvrDevice(int DeviceNumber, cDevice *ParentDevice)
           break;
     default:;
     }
+  log(pvrINFO, "settings for /dev/video%d only: pvrinput.%s", number, *cPvrSetup::CardSettingName(*BusID, "<Name>"));
+  LoadSetup();
   QueryAllControls(); //we have to split in mpeg and v4l2 here.
   memset(&inputs, -1, sizeof(inputs)); 
   numInputs = 0;
@@ -201,48 +285,37 @@ cPvrDevice::cPvrDevice(int DeviceNumber, cDevice *ParentDevice)
     hasTuner = false;
     log(pvrERROR, "device has no tuner");
     }
-  tsBuffer = new cRingBufferLinear(MEGABYTE(PvrSetup.TsBufferSizeMB), TS_SIZE, false, "PVRTS");
-  tsBuffer->SetTimeouts(100, 100);
-  ResetBuffering();
   GetStandard();
   if (driver == hdpvr) {
-    SetControlValue(&PvrSetup.HDPVR_AudioEncoding, PvrSetup.HDPVR_AudioEncoding.value);
-    SetAudioInput(PvrSetup.HDPVR_AudioInput);
+    SetControlValue(&setup.HDPVR_AudioEncoding, setup.HDPVR_AudioEncoding.value);
+    SetAudioInput(setup.HDPVR_AudioInput);
     }
   else {
-    SetControlValue(&PvrSetup.AudioEncoding, V4L2_MPEG_AUDIO_ENCODING_LAYER_2);
-    SetControlValue(&PvrSetup.VideoBitratePeak, 15000000);
+    SetControlValue(&setup.AudioEncoding, V4L2_MPEG_AUDIO_ENCODING_LAYER_2);
+    SetControlValue(&setup.VideoBitratePeak, 15000000);
     SetVideoSize(720, CurrentLinesPerFrame == 525 ? 480 : 576);
     /* the driver will later automatically adjust the height depending on standard changes */ 
     }
-  ReInit();
-  StartSectionHandler();
-  index = 0;
-  while ((index < kMaxPvrDevices) && (PvrDevices[index] != NULL))
-    index++;
-  if (index < kMaxPvrDevices)
-     PvrDevices[index] = this;
-  else {
-     index = -1;
-     esyslog("ERROR: too many cPvrDevices!");
-     }
 }
 
-cPvrDevice::~cPvrDevice()
+/*
+a virtual device which reads the file or named pipe given by the channel
+(FILE=<path>) instead of /dev/videoX. It has no controls and no tuner.
+*/
+void cPvrDevice::InitFileDevice(void)
 {
-  if ((index >= 0) && (index < kMaxPvrDevices) && (PvrDevices[index] == this))
-     PvrDevices[index] = NULL;
-#if VDRVERSNUM >= 10600
-  StopSectionHandler();
-#endif
-  DetachAllReceivers();
-  Stop();
-  cRingBufferLinear *tsBuffer_tmp = tsBuffer;
-  log(pvrDEBUG2, "~cPvrDevice()");
-  tsBuffer = NULL;
-  delete tsBuffer_tmp;
-  close(radio_fd);
-  close(v4l2_fd);
+  driver = file;
+  BusID = cString::sprintf("file%d", number - kFirstFileDevice);
+  log(pvrINFO, "cPvrDevice: file device %d, settings for it only: pvrinput.%s",
+      number, *cPvrSetup::CardSettingName(*BusID, "<Name>"));
+  hasTuner = false;
+  LoadSetup();
+  memset(&inputs, -1, sizeof(inputs));
+  inputs[eFile] = 0;
+  numInputs = 1;
+  CurrentInput = 0;
+  CurrentNorm = V4L2_STD_PAL;
+  CurrentLinesPerFrame = 625;
 }
 
 bool cPvrDevice::Probe(int DeviceNumber)
@@ -289,8 +362,9 @@ bool cPvrDevice::Initialize(void)
 #ifdef PVR_SOURCEPARAMS
   new cPvrSourceParam();
 #endif
-  for (int i = 0; i < kMaxPvrDevices; i++) {
+  for (int i = 0; i < kMaxDevices; i++)
     PvrDevices[i] = NULL;
+  for (int i = 0; i < kMaxPvrDevices; i++) {
     if (Probe(i)) {
 #ifdef __DYNAMIC_DEVICE_PROBE
       if (dynamite)
@@ -305,16 +379,22 @@ bool cPvrDevice::Initialize(void)
     log(pvrINFO, "cPvrDevice::Initialize(): found %d PVR device%s", found, found > 1 ? "s" : "");
   else
     log(pvrINFO, "cPvrDevice::Initialize(): no PVR device found");
+  int files = min(max(PvrSetup.FileDevices, 0), kMaxFileDevices);
+  for (int i = 0; i < files; i++)
+    new cPvrDevice(kFirstFileDevice + i);
+  if (files)
+    log(pvrINFO, "cPvrDevice::Initialize(): created %d file device%s", files, files > 1 ? "s" : "");
   externChannelSwitchScript = AddDirectory(cPlugin::ConfigDirectory(PLUGIN_NAME_I18N), "externchannelswitch.sh");
+  externChannelSwitchHelper = AddDirectory(cPlugin::ConfigDirectory(PLUGIN_NAME_I18N), "externchannelswitch-helper.sh");
   if (dynamite)
      dynamite->Service("dynamite-AddUdevMonitor-v0.1", (void*)("video4linux /dev/video"));
-  return found > 0;
+  return (found > 0) || (files > 0);
 }
 
 void cPvrDevice::StopAll(void)
 {
   /* recursively stop all threads inside pvrinputs devices */
-  for (int i = 0; i < kMaxPvrDevices; i++) {
+  for (int i = 0; i < kMaxDevices; i++) {
       if (PvrDevices[i])
          PvrDevices[i]->Stop();
       }
@@ -322,6 +402,13 @@ void cPvrDevice::StopAll(void)
 
 void cPvrDevice::Stop(void)
 {
+  StopTuneThread();
+  if (externHelper) {
+     delete externHelper;
+     externHelper = NULL;
+     }
+  lingering = false; // the tune thread is gone, stop the encoder here
+  preTuned = false;
   if (readThread) {
      log(pvrDEBUG2,"cPvrDevice::Stop() for Device %i", index);
      StopReadThread();
@@ -349,30 +436,55 @@ void cPvrDevice::GetStandard(void)
 
 void cPvrDevice::StopReadThread(void)
 {
-  if (readThreadRunning) {
+  cPvrReadThread *readThread_tmp;
+  {
+  cMutexLock lock(&stateMutex); // the tune thread may tear down a failed reader
+  while (recovering)            // the reader waits for it in RequestRecovery
+    stateCond.Wait(stateMutex);
+  recoveryRequest = 0;          // releases a reader waiting in RequestRecovery
+  stateCond.Broadcast();
+  readThread_tmp = readThread;
+  readThread = NULL;
+  }
+  if (readThread_tmp) {
      log(pvrDEBUG2, "cPvrDevice::StopReadThread on /dev/video%d (%s): read thread exists, delete it", number, CARDNAME[cardname]);
-     cPvrReadThread *readThread_tmp = readThread;
-     readThread = NULL;
      delete readThread_tmp;
      }
   else
      log(pvrDEBUG2, "cPvrDevice::StopReadThread: no read thread running on /dev/video%d (%s)", number, CARDNAME[cardname]);
 }
 
+void cPvrDevice::StopTuneThread(void)
+{
+  if (tuneThread) {
+     log(pvrDEBUG2, "cPvrDevice::StopTuneThread on /dev/video%d (%s)", number, CARDNAME[cardname]);
+     cPvrTuneThread *tuneThread_tmp = tuneThread;
+     tuneThread = NULL;
+     delete tuneThread_tmp;
+     }
+}
+
+/*
+called by the setup menu. Some settings require an encoder stop, so each
+device repeats its ReInit at its next OpenDvr.
+*/
 void cPvrDevice::ReInitAll(void)
 {
   log(pvrDEBUG1, "cPvrDevice::ReInitAll");
   int i;
-  for (i = 0; i < kMaxPvrDevices; i++) {
-    if (PvrDevices[i])
+  for (i = 0; i < kMaxDevices; i++) {
+    if (PvrDevices[i]) {
       PvrDevices[i]->ReInit();
+      cMutexLock lock(&PvrDevices[i]->stateMutex);
+      PvrDevices[i]->reInitPending = true;
+      }
     }
 }
 
 int cPvrDevice::Count()
 {
   int count = 0;
-  for (int i = 0; i < kMaxPvrDevices; i++) {
+  for (int i = 0; i < kMaxDevices; i++) {
     if (PvrDevices[i])
       count++;
     }
@@ -382,7 +494,7 @@ int cPvrDevice::Count()
 cPvrDevice *cPvrDevice::Get(int index)
 {
   int count = 0;
-  for (int i = 0; i < kMaxPvrDevices; i++) {
+  for (int i = 0; i < kMaxDevices; i++) {
     if (PvrDevices[i]) {
       if (count == index)
         return PvrDevices[i];
@@ -392,11 +504,14 @@ cPvrDevice *cPvrDevice::Get(int index)
   return NULL;
 }
 
-int  cPvrDevice::ReOpen(void)
+int  cPvrDevice::ReOpen(int Retries)
 {
   log(pvrDEBUG1, "cPvrDevice::ReOpen /dev/video%d = %s (%s)", number, CARDNAME[cardname], DRIVERNAME[driver]);
-  int retry_count = 5;
+  if (driver == file)
+    return v4l2_fd;
+  int retry_count = Retries;
   cString devName = cString::sprintf("/dev/video%d", number);
+  BeginFdChange();
   retry:
   close(v4l2_fd);
   v4l2_fd = open(devName, O_RDWR);
@@ -412,57 +527,243 @@ int  cPvrDevice::ReOpen(void)
   else {
     log(pvrDEBUG2, "cPvrDevice::ReOpen: %s (%s) successfully re-opened", *devName, CARDNAME[cardname]);
     }
+  EndFdChange();
   return v4l2_fd;
 }
 
+/*
+last step of the capture watchdog before it gives up: reopen the device, set
+all controls and the channel again and restart the encoder. Called by the
+tune thread from Recover(), without stateMutex, while vdr has the device open
+(or the encoder lingers). Channel is CurrentChannel when the step started.
+*/
+void cPvrDevice::Reinitialize(const cChannel &Channel)
+{
+  SetEncoderState(eStop);
+  if (ReOpen(1) < 0)
+     return;
+  int input = CurrentInput;
+  uint64_t norm = CurrentNorm;
+  int frequency = CurrentFrequency;
+  CurrentInput = -1;
+  CurrentNorm = 0;
+  CurrentFrequency = -1;
+  encoderProfile.Invalidate();
+  ReInit();
+  if (!SwitchToChannel(Channel, CurrentInputType, input, norm, frequency))
+     log(pvrERROR, "cPvrDevice::Reinitialize: tuning /dev/video%d failed", number);
+  if (CurrentInputType != eRadio)
+     ApplyEncoderProfile(profileLive);
+  if (CurrentInputType == eTelevision)
+     SetVBImode(CurrentLinesPerFrame, setup.SliceVBI ? V4L2_MPEG_STREAM_VBI_FMT_IVTV : V4L2_MPEG_STREAM_VBI_FMT_NONE);
+  SetEncoderState(eStart);
+}
+
+/*
+called by the read thread when its watchdog takes a step. The tune thread
+does it in Recover(), the read thread waits meanwhile as the fd may change.
+*/
+void cPvrDevice::RequestRecovery(int Step)
+{
+  cMutexLock lock(&stateMutex);
+  if (!readThread || !tuneThread)
+     return; // being stopped
+  recoveryRequest = Step;
+  stateCond.Broadcast();
+  while (recoveryRequest)
+    stateCond.TimedWait(stateMutex, 100);
+}
+
+/*
+called by the tune thread with stateMutex locked. The hardware work runs
+without the lock, recovering keeps OpenDvr and StopReadThread (CloseDvr)
+waiting meanwhile. A switch wanted by SetChannelDevice is done afterwards.
+*/
+void cPvrDevice::Recover(void)
+{
+  int step = recoveryRequest;
+  cChannel channel = CurrentChannel;
+  recovering = true;
+  stateMutex.Unlock();
+  switch (step) {
+    case 1:
+      SetEncoderState(eStop);
+      SetEncoderState(eStart);
+      break;
+    case 2:
+      SetEncoderState(eStop);
+      if (ReOpen(1) >= 0)
+         SetEncoderState(eStart);
+      break;
+    case 3:
+      Reinitialize(channel);
+      break;
+    }
+  stateMutex.Lock();
+  recovering = false;
+  recoveryRequest = 0;
+  stateCond.Broadcast();
+}
+
+/*
+called by the bitrate governor in the read or remux thread, which must not
+wait for the encoder: the tune thread applies the step
+*/
+void cPvrDevice::RequestBitrateLevel(int Level)
+{
+  cMutexLock lock(&stateMutex);
+  bitrateLevelWanted = Level;
+  stateCond.Broadcast();
+}
+
+int cPvrDevice::BitrateLevel(void) const
+{
+  cMutexLock lock(&stateMutex);
+  return bitrateLevel;
+}
+
+/*
+called by the tune thread without stateMutex: sets video bitrate and peak
+bitrate Level steps of BitrateGovernorStep below the current encoder profile,
+both in one VIDIOC_S_EXT_CTRLS, so the peak is never below the bitrate
+*/
+bool cPvrDevice::ApplyBitrateLevel(int Level)
+{
+  int percent = 100 - Level * setup.BitrateGovernorStep;
+  int bitrate = encoderProfile.VideoBitrateTV;
+  int peak = encoderProfile.VideoBitratePeak;
+  if (bitrate == INVALID_VALUE)
+     bitrate = setup.VideoBitrateTV.value;
+  if (peak == INVALID_VALUE)
+     peak = setup.VideoBitratePeak.value;
+  bitrate = constrain((int)((int64_t)bitrate * percent / 100), setup.VideoBitrateTV.queryctrl.minimum, setup.VideoBitrateTV.queryctrl.maximum);
+  peak = constrain((int)((int64_t)peak * percent / 100), setup.VideoBitratePeak.queryctrl.minimum, setup.VideoBitratePeak.queryctrl.maximum);
+  struct v4l2_ext_control ctrl[2];
+  struct v4l2_ext_controls ctrls;
+  memset(ctrl, 0, sizeof(ctrl));
+  memset(&ctrls, 0, sizeof(ctrls));
+  ctrl[0].id = V4L2_CID_MPEG_VIDEO_BITRATE;
+  ctrl[0].value = bitrate;
+  ctrl[1].id = V4L2_CID_MPEG_VIDEO_BITRATE_PEAK;
+  ctrl[1].value = max(peak, bitrate);
+  ctrls.ctrl_class = V4L2_CTRL_CLASS_MPEG;
+  ctrls.controls = ctrl;
+  ctrls.count = 2;
+  if (IOCTL(v4l2_fd, VIDIOC_S_EXT_CTRLS, &ctrls) != 0) {
+     log(pvrERROR, "cPvrBitrateGovernor: /dev/video%d refused %d kbit/s: %d:%s, the bitrate stays",
+         number, bitrate / 1000, errno, strerror(errno));
+     return false;
+     }
+  log(pvrINFO, "cPvrBitrateGovernor: video bitrate on /dev/video%d now %d kbit/s (%d%%)", number, bitrate / 1000, percent);
+  return true;
+}
+
+/*
+called by the read thread as the last thing before it ends on ENODEV or when
+the watchdog gave up
+*/
+void cPvrDevice::CaptureFailed(void)
+{
+  cMutexLock lock(&stateMutex);
+  captureFailed = true;
+  stateCond.Broadcast();
+}
+
+/*
+called by the tune thread with stateMutex locked: stops the encoder behind
+the failed read thread. GetTSPacket then returns false, so vdr closes the
+device.
+*/
+void cPvrDevice::TearDownFailed(void)
+{
+  log(pvrERROR, "cPvrDevice: capture on /dev/video%d (%s) failed, stopping it", number, CARDNAME[cardname]);
+  StopReadThread();
+  SetEncoderState(eStop);
+  SetVBImode(CurrentLinesPerFrame, V4L2_MPEG_STREAM_VBI_FMT_NONE);
+  lingering = false;
+  preTuned = false;
+  __atomic_store_n(&discardOutput, false, __ATOMIC_RELEASE);
+  stateCond.Broadcast();
+}
+
+/*
+the common settings, overridden by the ones stored for this BusID.
+The control ranges of the device are kept. The read thread uses some settings
+without locking, while it runs they are kept until the next StartEncoder.
+*/
+void cPvrDevice::LoadSetup(void)
+{
+  cPvrSetup s = PvrSetup;
+  s.ApplyCardSettings(*BusID);
+  cMutexLock lock(&stateMutex);
+  s.TakeControls(setup, false);
+  s.InitValues(driver == hdpvr);
+  setupDeferred = (readThread != NULL);
+  if (setupDeferred)
+     s.TakeReaderSettings(setup);
+  setup = s;
+}
+
+cPvrSetup *cPvrDevice::DeviceSetup(void)
+{
+  return &setup;
+}
+
+const char *cPvrDevice::GetBusID(void) const
+{
+  return *BusID;
+}
+
 void cPvrDevice::ReInit(void)
 {
   log(pvrDEBUG1, "cPvrDevice::ReInit /dev/video%d = %s (%s)", number, CARDNAME[cardname], DRIVERNAME[driver]);
-  SetControlValue(&PvrSetup.Brightness, PvrSetup.Brightness.value);
-  SetControlValue(&PvrSetup.Contrast, PvrSetup.Contrast.value);
-  SetControlValue(&PvrSetup.Saturation, PvrSetup.Saturation.value);
-  SetControlValue(&PvrSetup.Hue, PvrSetup.Hue.value);
-  SetControlValue(&PvrSetup.AspectRatio, PvrSetup.AspectRatio.value);
-  SetControlValue(&PvrSetup.FilterSpatialMode, PvrSetup.FilterSpatialMode.value);
-  SetControlValue(&PvrSetup.FilterSpatial, PvrSetup.FilterSpatial.value);
-  SetControlValue(&PvrSetup.FilterLumaSpatialType, PvrSetup.FilterLumaSpatialType.value);
-  SetControlValue(&PvrSetup.FilterChromaSpatialType, PvrSetup.FilterChromaSpatialType.value);
-  SetControlValue(&PvrSetup.FilterTemporalMode, PvrSetup.FilterTemporalMode.value);
-  SetControlValue(&PvrSetup.FilterTemporal, PvrSetup.FilterTemporal.value);
-  SetControlValue(&PvrSetup.FilterMedianType, PvrSetup.FilterMedianType.value);
-  SetControlValue(&PvrSetup.FilterLumaMedianBottom, PvrSetup.FilterLumaMedianBottom.value);
-  SetControlValue(&PvrSetup.FilterLumaMedianTop, PvrSetup.FilterLumaMedianTop.value);
-  SetControlValue(&PvrSetup.FilterChromaMedianBottom, PvrSetup.FilterChromaMedianBottom.value);
-  SetControlValue(&PvrSetup.FilterChromaMedianTop, PvrSetup.FilterChromaMedianTop.value);
+  LoadSetup();
+  SetControlValue(&setup.Brightness, setup.Brightness.value);
+  SetControlValue(&setup.Contrast, setup.Contrast.value);
+  SetControlValue(&setup.Saturation, setup.Saturation.value);
+  SetControlValue(&setup.Hue, setup.Hue.value);
+  SetControlValue(&setup.AspectRatio, setup.AspectRatio.value);
+  SetControlValue(&setup.FilterSpatialMode, setup.FilterSpatialMode.value);
+  SetControlValue(&setup.FilterSpatial, setup.FilterSpatial.value);
+  SetControlValue(&setup.FilterLumaSpatialType, setup.FilterLumaSpatialType.value);
+  SetControlValue(&setup.FilterChromaSpatialType, setup.FilterChromaSpatialType.value);
+  SetControlValue(&setup.FilterTemporalMode, setup.FilterTemporalMode.value);
+  SetControlValue(&setup.FilterTemporal, setup.FilterTemporal.value);
+  SetControlValue(&setup.FilterMedianType, setup.FilterMedianType.value);
+  SetControlValue(&setup.FilterLumaMedianBottom, setup.FilterLumaMedianBottom.value);
+  SetControlValue(&setup.FilterLumaMedianTop, setup.FilterLumaMedianTop.value);
+  SetControlValue(&setup.FilterChromaMedianBottom, setup.FilterChromaMedianBottom.value);
+  SetControlValue(&setup.FilterChromaMedianTop, setup.FilterChromaMedianTop.value);
 
   if ((radio_fd >= 0) || (driver == pvrusb2 && CurrentInput == inputs[eRadio])) {
-    SetControlValue(&PvrSetup.AudioVolumeFM, PvrSetup.AudioVolumeFM.value);
-    SetControlValue(&PvrSetup.AudioMute, (int) (PvrSetup.AudioVolumeFM.value == 0));
+    SetControlValue(&setup.AudioVolumeFM, setup.AudioVolumeFM.value);
+    SetControlValue(&setup.AudioMute, (int) (setup.AudioVolumeFM.value == 0));
     }
   else { //no radio
     SetAudioVolumeTV();
-    SetControlValue(&PvrSetup.AudioMute, (int) (PvrSetup.AudioVolumeTVCommon.value == 0));
+    SetControlValue(&setup.AudioMute, (int) (setup.AudioVolumeTVCommon.value == 0));
     }
 
   if (!dvrOpen) { 
-    SetTunerAudioMode(PvrSetup.TunerAudioMode);
+    SetTunerAudioMode(setup.TunerAudioMode);
     SetInput(CurrentInput);
     if ((driver == cx18) || (driver == hdpvr))
       streamType = V4L2_MPEG_STREAM_TYPE_MPEG2_TS;
-    else
-      streamType = (PvrSetup.StreamType.value == 0) ? V4L2_MPEG_STREAM_TYPE_MPEG2_PS : V4L2_MPEG_STREAM_TYPE_MPEG2_DVD;
-    SetControlValue(&PvrSetup.StreamType, streamType);
-    SetControlValue(&PvrSetup.AudioBitrate, PvrSetup.AudioBitrate.value);
-    SetControlValue(&PvrSetup.AudioSampling, PvrSetup.AudioSampling.value);
+    else if (driver != file) // the read thread looks at the file
+      streamType = (setup.StreamType.value == 0) ? V4L2_MPEG_STREAM_TYPE_MPEG2_PS : V4L2_MPEG_STREAM_TYPE_MPEG2_DVD;
+    SetControlValue(&setup.StreamType, streamType);
+    SetControlValue(&setup.AudioBitrate, setup.AudioBitrate.value);
+    SetControlValue(&setup.AudioSampling, setup.AudioSampling.value);
     if (driver == hdpvr) {
-      SetControlValue(&PvrSetup.HDPVR_AudioEncoding, PvrSetup.HDPVR_AudioEncoding.value);
-      SetAudioInput(PvrSetup.HDPVR_AudioInput);
+      SetControlValue(&setup.HDPVR_AudioEncoding, setup.HDPVR_AudioEncoding.value);
+      SetAudioInput(setup.HDPVR_AudioInput);
       }
-    SetControlValue(&PvrSetup.VideoBitrateTV, PvrSetup.VideoBitrateTV.value);
-    SetControlValue(&PvrSetup.BitrateMode, PvrSetup.BitrateMode.value);
-    SetControlValue(&PvrSetup.GopSize, PvrSetup.GopSize.queryctrl.default_value);
-    SetControlValue(&PvrSetup.GopClosure, PvrSetup.GopClosure.queryctrl.default_value);
-    SetControlValue(&PvrSetup.BFrames, PvrSetup.BFrames.queryctrl.default_value);
+    SetControlValue(&setup.VideoBitrateTV, setup.VideoBitrateTV.value);
+    SetControlValue(&setup.BitrateMode, setup.BitrateMode.value);
+    SetControlValue(&setup.GopSize, setup.GopSize.queryctrl.default_value);
+    SetControlValue(&setup.GopClosure, setup.GopClosure.queryctrl.default_value);
+    SetControlValue(&setup.BFrames, setup.BFrames.queryctrl.default_value);
+    encoderProfile.Invalidate(); // OpenDvr sets the profile again
     }
 }
 
@@ -521,7 +822,7 @@ bool cPvrDevice::SetInput(int input)
   if (driver == pvrusb2) {
     usleep(100000); /* 100msec */
     if (CurrentInput == inputs[eRadio])
-       SetControlValue(&PvrSetup.AudioVolumeFM, PvrSetup.AudioVolumeFM.value);
+       SetControlValue(&setup.AudioVolumeFM, setup.AudioVolumeFM.value);
     else //television or extern
        SetAudioVolumeTV();
     }
@@ -605,12 +906,12 @@ void cPvrDevice::SetTunerAudioMode(int tuneraudiomode)
 void cPvrDevice::SetAudioVolumeTV()
 {
   log(pvrDEBUG2, "AudioVolumeTVException.value=%d; AudioVolumeTVCommon.value=%d; number=%d, AudioVolumeTVExceptionCard=%d",
-                  PvrSetup.AudioVolumeTVException.value, PvrSetup.AudioVolumeTVCommon.value, number, PvrSetup.AudioVolumeTVExceptionCard);
+                  setup.AudioVolumeTVException.value, setup.AudioVolumeTVCommon.value, number, PvrSetup.AudioVolumeTVExceptionCard);
   if ((PvrSetup.AudioVolumeTVExceptionCard >= 0 && PvrSetup.AudioVolumeTVExceptionCard <= 7)
        && (number == PvrSetup.AudioVolumeTVExceptionCard)) { //special value selected for a /dev/videoX number
      log(pvrDEBUG1, "cPvrDevice::SetAudioVolumeTVException %d for /dev/video%d (%s)",
-         PvrSetup.AudioVolumeTVException.value, number, CARDNAME[cardname]);
-     SetControlValue(&PvrSetup.AudioVolumeTVException, PvrSetup.AudioVolumeTVException.value);
+         setup.AudioVolumeTVException.value, number, CARDNAME[cardname]);
+     SetControlValue(&setup.AudioVolumeTVException, setup.AudioVolumeTVException.value);
      }
   if (PvrSetup.AudioVolumeTVExceptionCard >= 9 && PvrSetup.AudioVolumeTVExceptionCard <=18) { //special value for card(s) with certain name
     if ((cardname == PVR150   && PvrSetup.AudioVolumeTVExceptionCard ==9)  ||
@@ -624,19 +925,20 @@ void cPvrDevice::SetAudioVolumeTV()
         (cardname == HVR1950  && PvrSetup.AudioVolumeTVExceptionCard ==17) ||
         (cardname == PVRUSB2  && PvrSetup.AudioVolumeTVExceptionCard ==18) ) {
             log(pvrDEBUG1, "cPvrDevice::SetAudioVolumeTVException %d for /dev/video%d (%s)",
-                PvrSetup.AudioVolumeTVException.value, number, CARDNAME[cardname]);
-            SetControlValue(&PvrSetup.AudioVolumeTVException, PvrSetup.AudioVolumeTVException.value);
+                setup.AudioVolumeTVException.value, number, CARDNAME[cardname]);
+            SetControlValue(&setup.AudioVolumeTVException, setup.AudioVolumeTVException.value);
             }
     }
   else { //no special value (PvrSetup.AudioVolumeTVExceptionCard ==8)
     log(pvrDEBUG1, "cPvrDevice::SetAudioVolumeTVCommon %d for /dev/video%d (%s)",
-        PvrSetup.AudioVolumeTVCommon.value, number, CARDNAME[cardname]);
-    SetControlValue(&PvrSetup.AudioVolumeTVCommon, PvrSetup.AudioVolumeTVCommon.value);
+        setup.AudioVolumeTVCommon.value, number, CARDNAME[cardname]);
+    SetControlValue(&setup.AudioVolumeTVCommon, setup.AudioVolumeTVCommon.value);
     }
 }
 
 void cPvrDevice::SetEncoderState(eEncState state)
 {
+  PVR_PROBE2(encoder_state, number, state == eStart);
   log(pvrDEBUG1, "cPvrDevice::SetEncoderState (%s) for /dev/video%d (%s)", state == eStop ? "Stop" : "Start", number, CARDNAME[cardname]);
   if (driver == ivtv || driver == cx18 || driver == hdpvr) {
     struct v4l2_encoder_cmd encoderCommand;
@@ -652,12 +954,15 @@ void cPvrDevice::SetEncoderState(eEncState state)
     }
   if (driver == pvrusb2 && state == eStop) {
     int retry_count = 5;
+    BeginFdChange();
     retry:
     close(v4l2_fd);
     v4l2_fd = -1;
     log(pvrDEBUG2, "cPvrDevice::SetEncoderState (eStop): /dev/video%d (%s) is closed",
         number, CARDNAME[cardname]);
+    stateMutex.Lock();
     pvrusb2_ready = false;
+    stateMutex.Unlock();
     cString devName = cString::sprintf("/dev/video%d", number);
     v4l2_fd = open(devName, O_RDWR);  //reopen for tuning
     if (v4l2_fd < 0) {
@@ -670,8 +975,11 @@ void cPvrDevice::SetEncoderState(eEncState state)
     else {
       log(pvrDEBUG2, "cPvrDevice::SetEncoderState (eStop): %s (%s) successfully re-opened",
           *devName, CARDNAME[cardname]);
+      cMutexLock lock(&stateMutex);
       pvrusb2_ready = true;
+      stateCond.Broadcast();
       }
+    EndFdChange();
    }
 }
 
@@ -745,11 +1053,11 @@ bool cPvrDevice::ParseChannel(const cChannel *Channel, int *input, uint64_t *nor
      int inputIndex = 0;
      int standardIndex = 0;
      int cardIndex = 0;
-     if (!cPvrSourceParam::ParseParameters(str, &inputIndex, &standardIndex, &cardIndex))
+     if (!str || !cPvrSourceParam::ParseChannel(Channel, str, &inputIndex, &standardIndex, &cardIndex))
         return false;
      *input = inputs[cPvrSourceParam::sInputType[inputIndex]];
      *inputType = cPvrSourceParam::sInputType[inputIndex];
-     if ((*inputType != eTelevision) && (*inputType != eRadio))
+     if ((*inputType != eTelevision) && (*inputType != eRadio) && (*inputType != eFile))
         *inputType = eExternalInput;
      if (standardIndex > 0) {
         *norm = cPvrSourceParam::sStandardNorm[standardIndex];
@@ -757,9 +1065,6 @@ bool cPvrDevice::ParseChannel(const cChannel *Channel, int *input, uint64_t *nor
         }
      if (cardIndex > 0)
         *card = cardIndex - 1;
-
-     log(pvrDEBUG2, "ParseChannel %s input %d, norm=0x%08llx, card %d",
-         (*inputType == eRadio) ? "Radio" : (*inputType == eTelevision) ? "TV" : "Ext", *input, *norm, *card);
      return true;
      }
   return false;
@@ -775,18 +1080,38 @@ bool cPvrDevice::SetChannelDevice(const cChannel * Channel, bool LiveView)
   if (!ParseChannel(Channel, &input, &norm, &LinesPerFrame, &card, &inputType, &apid, &vpid, &tpid))
      return false;
 
+  if (LiveView && PvrSetup.PreTune)
+     RecordWatched(Channel->Number());
+  if (LiveView)
+     __atomic_store_n(&zapStart, cTimeMs::Now(), __ATOMIC_RELEASE);
+  cMutexLock lock(&stateMutex);
+  liveView = LiveView;
+  preTunePending = false; // vdr wants the device now
   if ((Channel->GetChannelID() == CurrentChannel.GetChannelID()) && (Channel->Frequency() == CurrentFrequency) && (input == CurrentInput) && (norm == CurrentNorm))
     return true;
   log(pvrDEBUG1, "cPvrDevice::SetChannelDevice prepare switch to %d (%s) %3.2fMHz (/dev/video%d = %s)",
     Channel->Number(), Channel->Name(), (double)Channel->Frequency() / 1000,  number, CARDNAME[cardname]);
+  preTuneRequested = false;
+  QueueSwitch(Channel, input, norm, LinesPerFrame, inputType);
+  return true;
+}
+
+/*
+called with stateMutex locked: the tune thread starts switching as soon as
+the encoder is stopped
+*/
+void cPvrDevice::QueueSwitch(const cChannel *Channel, int Input, uint64_t Norm, int LinesPerFrame, eInputType InputType)
+{
   newFrequency = Channel->Frequency();
-  newInput = input;
-  newNorm = norm;
+  newInput = Input;
+  newNorm = Norm;
   newLinesPerFrame = LinesPerFrame;
-  newInputType = inputType;
+  newInputType = InputType;
   ChannelSettingsDone = false;
   CurrentChannel = *Channel;
-  return true;
+  tuneGeneration++;
+  tuneState = eTunePending;
+  stateCond.Broadcast();
 }
 
 bool cPvrDevice::SetPid(cPidHandle * Handle, int Type, bool On)
@@ -812,132 +1137,517 @@ void cPvrDevice::CloseFilter(int Handle)
 }
 #endif
 
+bool cPvrDevice::SwitchToChannel(const cChannel &Channel, eInputType inputType, int input, uint64_t norm, int frequency)
+{
+  switch (inputType) {
+    case eComposite0 ... eComposite4:   //no break here, continuing at next case item
+    case eSVideo0 ... eSVideo3:         //no break here, continuing at next case item
+    case eComponent:                    //no break here, continuing at next case item
+    case eExternalInput:
+          {
+          log(pvrDEBUG2, "channel is external input.");
+          if (radio_fd >= 0) {
+            close(radio_fd);
+            radio_fd = -1;
+            usleep(100000); /* 100msec */
+            SetAudioVolumeTV();
+            SetControlValue(&setup.VideoBitrateTV, setup.VideoBitrateTV.value);
+            encoderProfile.Invalidate();
+            }
+
+          if (PvrSetup.UseExternChannelSwitchScript && PvrSetup.ExternChannelSwitchHelper) {
+            if (!externHelper)
+               externHelper = new cPvrExternHelper(*externChannelSwitchHelper, number);
+            log(pvrDEBUG1, "SwitchToChannel: sending channel %d to %s", Channel.Number(), *externChannelSwitchHelper);
+            if (!externHelper->Switch(Channel, PvrSetup.ExternChannelSwitchTimeout))
+               return false;
+            }
+          else if (PvrSetup.UseExternChannelSwitchScript) {
+            cString cmd = cString::sprintf("%s %d %d %d %d",
+                            *externChannelSwitchScript, Channel.Sid(), Channel.Number(),
+                            number, Channel.Frequency());
+            log(pvrDEBUG1, "SwitchToChannel: calling %s", *cmd);
+            if (system(*cmd) < 0)
+               log(pvrERROR, "SwitchToChannel: executing %s failed", *cmd);
+            log(pvrDEBUG1, "SwitchToChannel: returned from %s", *cmd);
+            if (PvrSetup.ExternChannelSwitchSleep > 0) {
+              log(pvrDEBUG2, "SwitchToChannel: sleeping for %d seconds...", PvrSetup.ExternChannelSwitchSleep);
+              usleep(PvrSetup.ExternChannelSwitchSleep * 1000000);
+              log(pvrDEBUG2, "SwitchToChannel: waking up");
+              }
+            }
+
+          if (!SetInput(input))
+             return false;
+          if (!SetVideoNorm(norm))
+             return false;
+          CurrentFrequency = frequency; // since we don't tune: set it here
+          break;
+          }
+    case eRadio:
+          {
+          log(pvrDEBUG2,"channel is FM radio.");
+          switch (driver) {
+            case ivtv:
+            case cx18:
+            case pvrusb2:
+              if (*radio_devname == NULL)
+                 return false; //no hardware support.
+              if (radio_fd < 0) {
+                radio_fd = open(*radio_devname, O_RDONLY);
+                if (radio_fd < 0) {
+                  log(pvrERROR, "Error opening FM radio device %s: %s", *radio_devname, strerror(errno));
+                  return false;
+                  }
+                if (driver == pvrusb2)
+                   CurrentInput = inputs[eRadio]; //opening the radio_fd automatically switched the input
+                usleep(100000); /* 100msec */
+                SetControlValue(&setup.AudioVolumeFM, setup.AudioVolumeFM.value);
+                }
+              break;
+            case cx88_blackbird:
+            case hdpvr:
+              break;
+            case file: // ProvidesChannel doesn't let radio channels here
+            case undef:
+              log(pvrERROR, "driver is unknown!!");
+              return false;
+            }
+          if (!Tune(frequency))
+             return false;
+          break;
+          }
+    case eFile:
+          {
+          log(pvrDEBUG2, "channel is a file.");
+          if (!OpenFile(cPvrSourceParam::FileName(&Channel)))
+             return false;
+          CurrentFrequency = frequency;
+          break;
+          }
+    case eTelevision:
+          {
+          log(pvrDEBUG2, "channel is television.");
+          if (radio_fd >= 0) {
+            close(radio_fd);
+            radio_fd = -1;
+            usleep(100000); /* 100msec */
+            SetAudioVolumeTV();
+            SetControlValue(&setup.VideoBitrateTV, setup.VideoBitrateTV.value);
+            encoderProfile.Invalidate();
+            }
+          if (!SetInput(inputs[eTelevision]))
+             return false;
+          if (!SetVideoNorm(norm))
+             return false;
+          if (!Tune(frequency))
+             return false;
+          }
+    } //end: switch (inputType)
+  return true;
+}
+
+/*
+for file devices: opens the file or named pipe. The read thread finds out
+whether it is a program or a transport stream.
+*/
+bool cPvrDevice::OpenFile(const char *FileName)
+{
+  BeginFdChange();
+  if (v4l2_fd >= 0) {
+     close(v4l2_fd);
+     v4l2_fd = -1;
+     }
+  if (isempty(FileName)) {
+     EndFdChange();
+     log(pvrERROR, "cPvrDevice::OpenFile: no file name given in the channel, use FILE=<path>");
+     return false;
+     }
+  // a named pipe without writer must not block us
+  v4l2_fd = open(FileName, O_RDONLY | O_NONBLOCK);
+  EndFdChange();
+  if (v4l2_fd < 0) {
+     log(pvrERROR, "cPvrDevice::OpenFile: error opening %s: %d:%s", FileName, errno, strerror(errno));
+     return false;
+     }
+  struct stat st;
+  fileIsFifo = (fstat(v4l2_fd, &st) == 0) && S_ISFIFO(st.st_mode);
+  streamType = -1;
+  log(pvrINFO, "cPvrDevice::OpenFile: reading %s %s on file device %d", fileIsFifo ? "named pipe" : "file", FileName, number);
+  return true;
+}
+
 bool cPvrDevice::OpenDvr(void)
 {
   log(pvrDEBUG1, "entering cPvrDevice::OpenDvr: Dvr of /dev/video%d (%s) is %s",
       number, CARDNAME[cardname], (dvrOpen)?"open":"closed");
   delivered = false;
   CloseDvr();
-  while (dvrOpen) { //wait until CloseDvr has finnished
-    usleep(40000);
+  int linesPerFrame;
+  bool live;
+  bool reInit;
+  bool noRecording = (Priority() < 0); // not under stateMutex, it takes the receiver mutex
+  bool wrongProfile = false;
+  do {
+  if (wrongProfile) // not under stateMutex, it stops the read thread
+     EndLinger();
+  cMutexLock lock(&stateMutex);
+  while (dvrOpen || lingerStopping || recovering) { //wait until CloseDvr, EndLinger or a watchdog recovery has finnished
     log(pvrDEBUG1, "OpenDvr: wait for CloseDvr on /dev/video%d (%s) to finnish", number, CARDNAME[cardname]);
+    stateCond.Wait(stateMutex);
     }
-  tsBuffer->Clear();
-  ResetBuffering();
-  if (!dvrOpen) {
-     if (PvrSetup.repeat_ReInitAll_after_next_encoderstop) {
-        ReInitAll(); //some settings require an encoder stop, so we repeat them now
-        PvrSetup.repeat_ReInitAll_after_next_encoderstop = false;
-        }
-     if (!ChannelSettingsDone) {
-       if (driver == pvrusb2) {
-          while (!pvrusb2_ready) { //re-opening pvrusb2 in SetEncoderState might be in progress
-            usleep(40000);
-            log(pvrDEBUG1, "OpenDvr: wait until /dev/video%d (%s) is ready", number, CARDNAME[cardname]);
-            }
-          } 
-       switch (newInputType) {
-         case eComposite0 ... eComposite4:   //no break here, continuing at next case item
-         case eSVideo0 ... eSVideo3:         //no break here, continuing at next case item
-         case eComponent:                    //no break here, continuing at next case item
-         case eExternalInput:
-               {
-               log(pvrDEBUG2, "channel is external input.");
-               if (radio_fd >= 0) {
-                 close(radio_fd);
-                 radio_fd = -1;
-                 usleep(100000); /* 100msec */
-                 SetAudioVolumeTV();
-                 SetControlValue(&PvrSetup.VideoBitrateTV, PvrSetup.VideoBitrateTV.value);
-                 }
-
-               if (PvrSetup.UseExternChannelSwitchScript) {
-                 cString cmd = cString::sprintf("%s %d %d %d %d",
-                                 *externChannelSwitchScript, CurrentChannel.Sid(), CurrentChannel.Number(),
-                                 number, CurrentChannel.Frequency());
-                 log(pvrDEBUG1, "OpenDvr: calling %s", *cmd);
-                 if (system(*cmd) < 0)
-                    log(pvrERROR, "OpenDvr: executing %s failed", *cmd);
-                 log(pvrDEBUG1, "OpenDvr: returned from %s", *cmd);
-                 if (PvrSetup.ExternChannelSwitchSleep > 0) {
-                   log(pvrDEBUG2, "OpenDvr: sleeping for %d seconds...", PvrSetup.ExternChannelSwitchSleep);
-                   usleep(PvrSetup.ExternChannelSwitchSleep * 1000000);
-                   log(pvrDEBUG2, "OpenDvr: waking up");
-                   }
-                 }
-
-               if (!SetInput(newInput))
-                  return false;
-               if (!SetVideoNorm(newNorm))
-                  return false;
-               CurrentFrequency = newFrequency; // since we don't tune: set it here          
-               break;
-               }
-         case eRadio:
-               {
-               log(pvrDEBUG2,"channel is FM radio.");
-               switch (driver) {
-                 case ivtv:
-                 case cx18:
-                 case pvrusb2:
-                   if (*radio_devname == NULL)
-                      return false; //no hardware support.
-                   if (radio_fd < 0) {
-                     radio_fd = open(*radio_devname, O_RDONLY);
-                     if (radio_fd < 0) {
-                       log(pvrERROR, "Error opening FM radio device %s: %s", *radio_devname, strerror(errno));
-                       return false;
-                       }
-                     if (driver == pvrusb2)
-                        CurrentInput = inputs[eRadio]; //opening the radio_fd automatically switched the input
-                     usleep(100000); /* 100msec */
-                     SetControlValue(&PvrSetup.AudioVolumeFM, PvrSetup.AudioVolumeFM.value);
-                     }
-                   break;
-                 case cx88_blackbird:
-                 case hdpvr:
-                   break;
-                 case undef:
-                   log(pvrERROR, "driver is unknown!!");
-                   return false;
-                 }
-               if (!Tune(newFrequency))
-                  return false;
-               break;
-               }
-         case eTelevision:
-               {
-               log(pvrDEBUG2, "channel is television.");
-               if (radio_fd >= 0) {
-                 close(radio_fd);
-                 radio_fd = -1;
-                 usleep(100000); /* 100msec */
-                 SetAudioVolumeTV();
-                 SetControlValue(&PvrSetup.VideoBitrateTV, PvrSetup.VideoBitrateTV.value);
-                 }
-               if (!SetInput(inputs[eTelevision]))
-                  return false;
-               if (!SetVideoNorm(newNorm))
-                  return false;
-               if (!Tune(newFrequency))
-                  return false;
-               }
-         } //end: switch (newInputType)
-       CurrentInputType = newInputType;
-       ChannelSettingsDone = true;
-       } //end: if ((!ChannelSettingsDone)
-     if (CurrentInputType == eTelevision)
-        SetVBImode(newLinesPerFrame, PvrSetup.SliceVBI ? V4L2_MPEG_STREAM_VBI_FMT_IVTV : V4L2_MPEG_STREAM_VBI_FMT_NONE);
-     SetEncoderState(eStart);
-     if (!readThreadRunning) {
-        log(pvrDEBUG2, "cPvrDevice::OpenDvr: create new readThread on /dev/video%d (%s)", number, CARDNAME[cardname]);
-        readThread = new cPvrReadThread(tsBuffer, this);
-        }
-     } //end: if (!dvrOpen)
+  /* the channel switch was started by SetChannelDevice, wait until the tune thread is done */
+  uint64_t deadline = cTimeMs::Now() + 10000;
+  if (PvrSetup.ExternChannelSwitchHelper)
+     deadline += max(PvrSetup.ExternChannelSwitchTimeout, 0);
+  else
+     deadline += max(PvrSetup.ExternChannelSwitchSleep, 0) * 1000;
+  while ((tuneState == eTunePending) || (tuneState == eTuneSwitching)) {
+    int remaining = (int)(deadline - cTimeMs::Now());
+    if (!tuneThread || (remaining <= 0)) {
+       log(pvrERROR, "OpenDvr: %s while switching channel on /dev/video%d (%s)",
+           tuneThread ? "timeout" : "no tune thread", number, CARDNAME[cardname]);
+       return false;
+       }
+    stateCond.TimedWait(stateMutex, remaining);
+    }
+  /* e.g. a recording on a pre-tuned encoder with the live profile: the
+     encoder has to be started again with the other profile */
+  wrongProfile = lingering && (tuneState != eTunePending) && (profileLive != (liveView && noRecording));
+  if (wrongProfile) {
+     log(pvrDEBUG1, "OpenDvr: lingering encoder on /dev/video%d (%s) has the %s profile, restarting it",
+         number, CARDNAME[cardname], profileLive ? "live" : "recording");
+     continue;
+     }
+  if (lingering && (tuneState != eTunePending)) {
+     /* same channel again while the encoder is still running, or a pre-tune
+        finished meanwhile: just deliver again */
+     lingering = false;
+     preTuned = false;
+     tsBufferInUse = true;
+     tsBuffer->Clear();
+     ResetBuffering(liveView && noRecording);
+     __atomic_store_n(&discardOutput, false, __ATOMIC_RELEASE);
+     dvrOpen = true;
+     stateCond.Broadcast();
+     log(pvrDEBUG1, "OpenDvr: resumed lingering or pre-tuned encoder on /dev/video%d (%s)", number, CARDNAME[cardname]);
+     return true;
+     }
+  if (tuneState == eTuneFailed) {
+     log(pvrERROR, "OpenDvr: channel switch failed on /dev/video%d (%s)", number, CARDNAME[cardname]);
+     tuneState = eTunePending; // retry on the next OpenDvr
+     stateCond.Broadcast();
+     return false;
+     }
+  AllocateBuffer();
+  tsBufferInUse = true;
+  captureFailed = false;
+  linesPerFrame = newLinesPerFrame;
+  live = liveView;
+  reInit = reInitPending;
+  reInitPending = false;
+  } while (wrongProfile);
+  if (reInit)
+     ReInit(); //some settings require an encoder stop, so we repeat them now
+  StartEncoder(linesPerFrame, live && noRecording);
+  cMutexLock lock(&stateMutex);
   dvrOpen = true;
   return true;
 }
 
+void cPvrDevice::StartEncoder(int LinesPerFrame, bool Live)
+{
+  {
+  cMutexLock lock(&stateMutex);
+  if (setupDeferred && !readThread)
+     LoadSetup();
+  if (bitrateLevel || bitrateLevelWanted) { // the governor changed the bitrate, send the profile again
+     encoderProfile.VideoBitrateTV = INVALID_VALUE;
+     encoderProfile.VideoBitratePeak = INVALID_VALUE;
+     bitrateLevel = bitrateLevelWanted = 0;
+     }
+  }
+  tsBuffer->Clear();
+  ResetBuffering(Live);
+  if (CurrentInputType != eRadio)
+     ApplyEncoderProfile(Live);
+  if (CurrentInputType == eTelevision)
+     SetVBImode(LinesPerFrame, setup.SliceVBI ? V4L2_MPEG_STREAM_VBI_FMT_IVTV : V4L2_MPEG_STREAM_VBI_FMT_NONE);
+  SetEncoderState(eStart);
+  if (!readThreadRunning) {
+     log(pvrDEBUG2, "cPvrDevice::StartEncoder: create new readThread on /dev/video%d (%s)", number, CARDNAME[cardname]);
+     cMutexLock lock(&stateMutex);
+     readThread = new cPvrReadThread(tsBuffer, this);
+     }
+}
+
+/*
+called by the tune thread with stateMutex locked when PreTune() chose a
+channel for this device: switches like SetChannelDevice, but without vdr
+knowing about it, and starts the encoder afterwards
+*/
+void cPvrDevice::StartPreTune(void)
+{
+  preTunePending = false;
+  if (dvrOpen || lingerStopping || (tuneState == eTunePending))
+     return; // vdr was faster
+  int input, linesPerFrame, card, a, v, t;
+  uint64_t norm;
+  eInputType inputType;
+  if (!ParseChannel(&preTuneChannel, &input, &norm, &linesPerFrame, &card, &inputType, &a, &v, &t))
+     return;
+  log(pvrDEBUG1, "cPvrDevice::PreTune: /dev/video%d (%s) -> %d (%s)",
+      number, CARDNAME[cardname], preTuneChannel.Number(), preTuneChannel.Name());
+  apid = a;
+  vpid = v;
+  tpid = t;
+  preTuneRequested = true;
+  QueueSwitch(&preTuneChannel, input, norm, linesPerFrame, inputType);
+}
+
+/*
+called by the tune thread after it switched to a channel chosen by PreTune():
+the encoder runs like after CloseDvr with EncoderLingerMs, but until vdr wants
+the channel or the device gets another one
+*/
+void cPvrDevice::StartPreTuned(void)
+{
+  int linesPerFrame;
+  {
+  cMutexLock lock(&stateMutex);
+  if (dvrOpen || lingering || readThreadRunning)
+     return;
+  AllocateBuffer();
+  linesPerFrame = newLinesPerFrame;
+  }
+  __atomic_store_n(&discardOutput, true, __ATOMIC_RELEASE);
+  StartEncoder(linesPerFrame, true);
+  cMutexLock lock(&stateMutex);
+  lingering = true;
+  preTuned = true;
+  log(pvrDEBUG1, "cPvrDevice: /dev/video%d (%s) pre-tuned to %d (%s)",
+      number, CARDNAME[cardname], CurrentChannel.Number(), CurrentChannel.Name());
+}
+
+/*
+remembers the channels watched live, PreTune = 2 pre-tunes the most watched
+ones. Main thread only, like SetChannelDevice and PreTune.
+*/
+cPvrDevice::tWatched cPvrDevice::watched[kMaxWatched];
+
+void cPvrDevice::RecordWatched(int ChannelNumber)
+{
+  int i;
+  for (i = 0; i < kMaxWatched - 1; i++) {
+      if ((watched[i].number == ChannelNumber) || !watched[i].count)
+         break;
+      }
+  // i is the channel, a free slot or the least watched one
+  if (watched[i].number != ChannelNumber) {
+     watched[i].number = ChannelNumber;
+     watched[i].count = 0;
+     }
+  watched[i].count++;
+  // keep the list sorted
+  for (; (i > 0) && (watched[i].count > watched[i - 1].count); i--) {
+      tWatched tmp = watched[i];
+      watched[i] = watched[i - 1];
+      watched[i - 1] = tmp;
+      }
+}
+
+/*
+an idle device which isn't pre-tuned leaves a channel to the idle device which
+already encodes it. The state of each device is read under its own
+stateMutex, one device at a time.
+*/
+bool cPvrDevice::PreTunedElsewhere(const cChannel *Channel) const
+{
+  if (!PvrSetup.PreTune)
+     return false;
+  {
+  cMutexLock lock(&stateMutex);
+  if (dvrOpen || preTuned)
+     return false;
+  }
+  tChannelID id = Channel->GetChannelID();
+  for (int i = 0; i < kMaxDevices; i++) {
+      cPvrDevice *dev = PvrDevices[i];
+      if (!dev || (dev == this))
+         continue;
+      cMutexLock lock(&dev->stateMutex);
+      if (dev->preTuned && dev->lingering && !dev->dvrOpen && (dev->CurrentChannel.GetChannelID() == id))
+         return true;
+      }
+  return false;
+}
+
+/*
+called from the main thread: lets idle devices switch to the channels most
+likely wanted next, the neighbours of the live channel and with PreTune = 2
+also the most watched ones. Each device only takes one channel and devices
+in use are left alone, a recording simply tunes a pre-tuned device away.
+The state of the devices is read under their stateMutex, the switch itself
+is done by the tune thread of the chosen device.
+*/
+void cPvrDevice::PreTune(void)
+{
+  static cTimeMs timer;
+  if (!PvrSetup.PreTune || (timer.Elapsed() < 2000))
+     return;
+  timer.Set();
+  cChannel candidates[2 + kMaxWatched];
+  int numCandidates = 0;
+  {
+#if VDRVERSNUM > 20300
+  LOCK_CHANNELS_READ
+  const cChannels *vdrchannels = Channels;
+#else
+  cChannels *vdrchannels = &Channels;
+#endif
+  int current = cDevice::CurrentChannel();
+  const cChannel *next = vdrchannels->GetByNumber(current + 1, 1);
+  const cChannel *prev = vdrchannels->GetByNumber(current - 1, -1);
+  if (next && (next->Number() != current))
+     candidates[numCandidates++] = *next;
+  if (prev && (prev->Number() != current) && (!next || (prev->Number() != next->Number())))
+     candidates[numCandidates++] = *prev;
+  if (PvrSetup.PreTune >= 2) {
+     for (int i = 0; (i < kMaxWatched) && watched[i].count; i++) {
+         const cChannel *channel = vdrchannels->GetByNumber(watched[i].number);
+         if (channel && (channel->Number() != current))
+            candidates[numCandidates++] = *channel;
+         }
+     }
+  }
+  struct {
+    bool busy;
+    bool preTuned;
+    tChannelID channel;
+  } state[kMaxDevices];
+  for (int i = 0; i < kMaxDevices; i++) {
+      cPvrDevice *dev = PvrDevices[i];
+      if (!dev)
+         continue;
+      cMutexLock lock(&dev->stateMutex);
+      state[i].busy = dev->dvrOpen || dev->lingerStopping;
+      state[i].preTuned = dev->preTuned || dev->preTunePending;
+      state[i].channel = dev->preTunePending ? dev->preTuneChannel.GetChannelID() : dev->CurrentChannel.GetChannelID();
+      }
+  bool used[kMaxDevices] = { false };
+  for (int c = 0; c < numCandidates; c++) {
+      const cChannel *channel = &candidates[c];
+      int found = -1;
+      for (int i = 0; (i < kMaxDevices) && (found < 0); i++) { // already there?
+          if (PvrDevices[i] && (state[i].preTuned || state[i].busy) && (state[i].channel == channel->GetChannelID()))
+             found = i;
+          }
+      if (found >= 0) {
+         used[found] = true;
+         continue;
+         }
+      // an idle device, rather one which isn't pre-tuned yet
+      for (int pass = 0; (pass < 2) && (found < 0); pass++) {
+          for (int i = 0; (i < kMaxDevices) && (found < 0); i++) {
+              cPvrDevice *dev = PvrDevices[i];
+              if (!dev || used[i] || state[i].busy || dev->Receiving(true) || (state[i].preTuned && (pass == 0)))
+                 continue;
+              if (dev->ProvidesChannel(channel, IDLEPRIORITY))
+                 found = i;
+              }
+          }
+      if (found < 0)
+         continue;
+      used[found] = true;
+      cPvrDevice *dev = PvrDevices[found];
+      cMutexLock lock(&dev->stateMutex);
+      if (dev->dvrOpen || dev->lingerStopping || !dev->tuneThread)
+         continue;
+      dev->preTuneChannel = *channel;
+      dev->preTunePending = true;
+      dev->stateCond.Broadcast();
+      }
+}
+
+/*
+the ring buffer is allocated by the first OpenDvr, not for every card found,
+and again if TsBufferSizeMB was changed meanwhile. Called with stateMutex
+locked, the read thread isn't running.
+*/
+void cPvrDevice::AllocateBuffer(void)
+{
+  int size = MEGABYTE(PvrSetup.TsBufferSizeMB);
+  if (tsBuffer && (tsBufferSize == size))
+     return;
+  delete tsBuffer;
+  tsBuffer = new cRingBufferLinear(size, TS_SIZE, false, "PVRTS");
+  tsBuffer->SetTimeouts(100, 100);
+  tsBufferSize = size;
+  log(pvrDEBUG1, "cPvrDevice::OpenDvr: allocated %d MB ring buffer for /dev/video%d, buffers use %d KB in total",
+      PvrSetup.TsBufferSizeMB, number, TotalBufferMemory() / 1024);
+}
+
+/*
+called by Housekeeping: frees ring buffers and read buffers which weren't
+used for TsBufferIdleRelease seconds
+*/
+void cPvrDevice::ReleaseIdleBuffers(void)
+{
+  int idle = PvrSetup.TsBufferIdleRelease;
+  if (idle <= 0)
+     return;
+  time_t now = time(NULL);
+  for (int i = 0; i < kMaxDevices; i++) {
+      cPvrDevice *dev = PvrDevices[i];
+      if (!dev)
+         continue;
+      cMutexLock lock(&dev->stateMutex);
+      if (dev->tsBuffer && !dev->tsBufferInUse && !dev->readThreadRunning && (now - dev->tsBufferIdleSince >= idle)) {
+         delete dev->tsBuffer;
+         dev->tsBuffer = NULL;
+         dev->tsBufferSize = 0;
+         log(pvrDEBUG1, "cPvrDevice: released ring buffer of idle /dev/video%d, buffers use %d KB in total",
+             dev->number, TotalBufferMemory() / 1024);
+         }
+      }
+  PvrReadBuffers.Trim(idle);
+}
+
+int cPvrDevice::TotalBufferMemory(void)
+{
+  int total = PvrReadBuffers.Allocated();
+  for (int i = 0; i < kMaxDevices; i++) {
+      if (PvrDevices[i] && PvrDevices[i]->tsBuffer)
+         total += PvrDevices[i]->tsBufferSize;
+      }
+  return total;
+}
+
+/*
+stops the encoder left running by CloseDvr. Called by the tune thread without
+stateMutex locked.
+*/
+void cPvrDevice::EndLinger(void)
+{
+  {
+  cMutexLock lock(&stateMutex);
+  if (!lingering)
+     return;
+  lingering = false;
+  preTuned = false;
+  lingerStopping = true;
+  }
+  log(pvrDEBUG2, "cPvrDevice::EndLinger: stopping encoder of /dev/video%d (%s)", number, CARDNAME[cardname]);
+  StopReadThread();
+  SetEncoderState(eStop);
+  SetVBImode(CurrentLinesPerFrame, V4L2_MPEG_STREAM_VBI_FMT_NONE);
+  __atomic_store_n(&discardOutput, false, __ATOMIC_RELEASE);
+  cMutexLock lock(&stateMutex);
+  tsBufferIdleSince = time(NULL);
+  lingerStopping = false;
+  stateCond.Broadcast();
+}
+
 void cPvrDevice::CloseDvr(void)
 {
   if (isClosing)
@@ -945,19 +1655,69 @@ void cPvrDevice::CloseDvr(void)
   isClosing = true;
   log(pvrDEBUG2, "entering cPvrDevice::CloseDvr: Dvr of /dev/video%d (%s) is %s",
       number, CARDNAME[cardname], (dvrOpen)?"open":"closed");
-  if (dvrOpen) {
+  bool linger = dvrOpen && readThreadRunning && !captureFailed && (PvrSetup.EncoderLingerMs > 0);
+  if (linger)
+     __atomic_store_n(&discardOutput, true, __ATOMIC_RELEASE);
+  else if (dvrOpen) {
      StopReadThread();
      SetEncoderState(eStop);
      SetVBImode(CurrentLinesPerFrame, V4L2_MPEG_STREAM_VBI_FMT_NONE);
      }
+  cMutexLock lock(&stateMutex);
+  if (linger) {
+     lingering = true;
+     lingerUntil = cTimeMs::Now() + PvrSetup.EncoderLingerMs;
+     log(pvrDEBUG2, "cPvrDevice::CloseDvr: encoder of /dev/video%d (%s) keeps running for %d ms",
+         number, CARDNAME[cardname], PvrSetup.EncoderLingerMs);
+     }
   dvrOpen = false;
+  tsBufferInUse = false;
+  tsBufferIdleSince = time(NULL);
   isClosing = false;
+  stateCond.Broadcast(); // wakes the tune thread and a waiting OpenDvr
+}
+
+/*
+sets the encoder controls of the live or recording profile,
+but only those which differ from the values sent last time
+*/
+void cPvrDevice::ApplyEncoderProfile(bool Live)
+{
+  const cPvrEncoderProfile &p = Live ? setup.LiveProfile : setup.RecordingProfile;
+  profileLive = Live;
+  log(pvrDEBUG1, "cPvrDevice::ApplyEncoderProfile(%s) on /dev/video%d (%s)", Live ? "live" : "recording", number, CARDNAME[cardname]);
+  #define PROFILE(v, vs) ((p.v != INVALID_VALUE) ? p.v : vs.value)
+  ApplyEncoderControl(encoderProfile.BitrateMode,      PROFILE(BitrateMode, setup.BitrateMode),           setup.BitrateMode);
+  ApplyEncoderControl(encoderProfile.VideoBitratePeak, PROFILE(VideoBitratePeak, setup.VideoBitratePeak), setup.VideoBitratePeak);
+  ApplyEncoderControl(encoderProfile.VideoBitrateTV,   PROFILE(VideoBitrateTV, setup.VideoBitrateTV),     setup.VideoBitrateTV);
+  #undef PROFILE
+  // ReInit sets the driver defaults for these
+  #define PROFILE(v, vs) ((p.v != INVALID_VALUE) ? p.v : vs.queryctrl.default_value)
+  ApplyEncoderControl(encoderProfile.GopSize,          PROFILE(GopSize, setup.GopSize),                   setup.GopSize);
+  ApplyEncoderControl(encoderProfile.GopClosure,       PROFILE(GopClosure, setup.GopClosure),             setup.GopClosure);
+  ApplyEncoderControl(encoderProfile.BFrames,          PROFILE(BFrames, setup.BFrames),                   setup.BFrames);
+  #undef PROFILE
 }
 
-void cPvrDevice::ResetBuffering()
+void cPvrDevice::ApplyEncoderControl(int &Applied, int Value, valSet &vs)
+{
+  if (Value == Applied)
+     return;
+  SetControlValue(vs.ctrl_class, vs.queryctrl.id, Value, vs.queryctrl);
+  Applied = Value;
+}
+
+/*
+Live: only a live viewer, CaptureMode then delivers without prefill
+*/
+void cPvrDevice::ResetBuffering(bool Live)
 {
   tsBufferPrefill = (MEGABYTE(PvrSetup.TsBufferSizeMB) * PvrSetup.TsBufferPrefillRatio) / 100;
   tsBufferPrefill -= (tsBufferPrefill % TS_SIZE);
+  if (Live && (PvrSetup.CaptureMode > 0))
+     tsBufferPrefill = 0;
+  if (PvrSetup.GopAlign)
+     __atomic_store_n(&gopAlign, true, __ATOMIC_RELEASE);
   log(pvrDEBUG2, "cPvrDevice::ResetBuffering(): tsBuffer prefill = %d for /dev/video%d (%s)",
       tsBufferPrefill, number, CARDNAME[cardname]);
 }
@@ -978,10 +1738,10 @@ bool cPvrDevice::GetTSPacket(uchar *&Data)
 {
   int Count = 0;
   if (!tsBuffer ) {
-    log(pvrERROR, "cPvrDevice::GetTSPacket(): no tsBuffer for /dev/video%d (%s)", number, CARDNAME[cardname]);
+    dlog(pvrERROR, "cPvrDevice::GetTSPacket(): no tsBuffer for /dev/video%d (%s)", number, CARDNAME[cardname]);
     return false;
     }
-  if (tsBuffer && readThreadRunning) {
+  if (tsBuffer && readThreadRunning && !captureFailed) {
     if (!IsBuffering()) {
       if (delivered) {
         tsBuffer->Del(TS_SIZE);
@@ -998,10 +1758,19 @@ bool cPvrDevice::GetTSPacket(uchar *&Data)
               } //end: if
             } //end: for
           tsBuffer->Del(Count);
-          log(pvrINFO, "ERROR: cPvrDevice::GetTSPacket(): skipped %d bytes to sync on TS packet\n", Count);
+          stats.SyncSkipped(Count);
+          dlog(pvrINFO, "ERROR: cPvrDevice::GetTSPacket(): skipped %d bytes to sync on TS packet\n", Count);
           return false;
           }
+        PVR_PROBE2(get_ts_packet, number, Count);
         sectionHandler.ProcessTSPacket(p);
+        if (zapStart) {
+          uint64_t start = __atomic_exchange_n(&zapStart, 0, __ATOMIC_ACQ_REL);
+          if (start) {
+            lastZapMs = (int)(cTimeMs::Now() - start);
+            stats.Zap(lastZapMs);
+            }
+          }
         delivered = true;
         Data = p;
         return true;
@@ -1014,6 +1783,48 @@ bool cPvrDevice::GetTSPacket(uchar *&Data)
   return false;
 }
 
+/*
+called by IOCTL() before it tries again
+*/
+void cPvrDevice::IoctlRetried(int Fd)
+{
+  for (int i = 0; i < kMaxDevices; i++) {
+      cPvrDevice *dev = PvrDevices[i];
+      if (dev && ((dev->v4l2_fd == Fd) || (dev->radio_fd == Fd))) {
+         __atomic_fetch_add(&dev->ioctlRetries, 1, __ATOMIC_RELAXED);
+         break;
+         }
+      }
+}
+
+const char *cPvrDevice::CardName(void) const
+{
+  return CARDNAME[cardname];
+}
+
+/*
+for the statistics page, doesn't touch the hardware
+*/
+void cPvrDevice::GetStats(tPvrStats &Stats, bool Signal)
+{
+  stats.Get(Stats, cTimeMs::Now());
+  Stats.active = readThreadRunning;
+  Stats.lastZapMs = lastZapMs;
+  Stats.signal = Signal ? SignalStrength() : -1; // keeps the sampler running
+  drift.GetStats(Stats.drift);
+  Stats.bufferFill = 0;
+  Stats.prefill = 0;
+  cMutexLock lock(&stateMutex);
+  Stats.bufferMemory = BufferMemory();
+  if (tsBuffer && tsBufferInUse) {
+     int size = tsBuffer->Size();
+     int avail = tsBuffer->Available();
+     Stats.bufferFill = size ? (int)((100LL * avail) / size) : 0;
+     if (tsBufferPrefill > avail)
+        Stats.prefill = size ? (int)((100LL * (tsBufferPrefill - avail)) / size) : 0;
+     }
+}
+
 bool cPvrDevice::ProvidesSource(int Source) const
 {
   bool isPvr = cPvrSourceParam::IsPvr(Source);
@@ -1031,18 +1842,83 @@ int cPvrDevice::NumProvidedSystems(void) const
   return 1;
 }
 
+/*
+returns the value sampled by the tune thread every SignalSampleMs, so skins
+polling the signal meter neither wait for the ioctl nor get in the way of a
+channel switch. The sampler pauses while nobody asks.
+*/
 int cPvrDevice::SignalStrength(void) const
 {
+  if (driver == file)
+     return -1;
+  if ((PvrSetup.SignalSampleMs <= 0) || !tuneThread) {
+     int strength;
+     return ReadSignalStrength(strength) ? strength : -1;
+     }
+  uint64_t now = cTimeMs::Now();
+  uint64_t last = __atomic_exchange_n(&signalLastRequest, now, __ATOMIC_ACQ_REL);
+  if (now - last > (uint64_t)kSignalIdleMs) { // wake up the paused sampler
+     cMutexLock lock(&stateMutex);
+     stateCond.Broadcast();
+     }
+  return __atomic_load_n(&signalStrength, __ATOMIC_ACQUIRE);
+}
+
+/*
+v4l2_fd is closed and reopened without stateMutex (ReOpen, OpenFile, the eStop
+of pvrusb2). BeginFdChange waits for a running VIDIOC_G_TUNER and keeps new
+ones from starting until EndFdChange.
+*/
+void cPvrDevice::BeginFdChange(void)
+{
+  cMutexLock lock(&stateMutex);
+  fdChanges++;
+  while (signalSampling)
+    stateCond.Wait(stateMutex);
+}
+
+void cPvrDevice::EndFdChange(void)
+{
+  cMutexLock lock(&stateMutex);
+  fdChanges--;
+  stateCond.Broadcast();
+}
+
+/*
+returns false without asking the driver while v4l2_fd is being reopened or
+the tune thread is switching the channel. Must not be called with stateMutex
+locked.
+*/
+bool cPvrDevice::ReadSignalStrength(int &Strength) const
+{
+  stateMutex.Lock();
+  if (fdChanges || (tuneState == eTuneSwitching) || (v4l2_fd < 0)) {
+     stateMutex.Unlock();
+     return false;
+     }
+  int fd = v4l2_fd; // stays valid while signalSampling is set
+  signalSampling = true;
+  stateMutex.Unlock();
   struct v4l2_tuner tuner;
   memset(&tuner, 0, sizeof(tuner));
-  if ((IOCTL(v4l2_fd, VIDIOC_G_TUNER, &tuner) == 0) && (tuner.signal >= 0) && (tuner.signal <= 65535))
-     return (tuner.signal * 100) / 65535;
-  return -1;
+  Strength = -1;
+  if ((IOCTL(fd, VIDIOC_G_TUNER, &tuner) == 0) && (tuner.signal >= 0) && (tuner.signal <= 65535))
+     Strength = (tuner.signal * 100) / 65535;
+  cMutexLock lock(&stateMutex);
+  signalSampling = false;
+  stateCond.Broadcast();
+  return true;
 }
 
+/*
+estimated by the read thread from VBI decoding errors and stream errors, see
+quality.h
+*/
 int cPvrDevice::SignalQuality(void) const
 {
-  return -1;
+  if (!readThreadRunning)
+     return -1;
+  return quality.Quality();
 }
 
 const cChannel *cPvrDevice::GetCurrentlyTunedTransponder(void) const
@@ -1109,6 +1985,10 @@ bool cPvrDevice::ProvidesChannel(const cChannel *Channel, int Priority, bool *Ne
            return false;
            }
     }
+  if ((inputType == eFile) != (driver == file)) {
+    log(pvrDEBUG2, "cPvrDevice::ProvidesChannel %s -> false (file channels only on file devices)", Channel->Name());
+    return false;
+    }
   if (inputType == eRadio) {
     if (*radio_devname == NULL) {
       log(pvrDEBUG1, "cPvrDevice::ProvidesChannel: /dev/video%d (%s) has no radio", number, CARDNAME[cardname]);
@@ -1131,12 +2011,16 @@ bool cPvrDevice::ProvidesChannel(const cChannel *Channel, int Priority, bool *Ne
     }
   else
     result = hasPriority;
+  if (result && PreTunedElsewhere(Channel)) {
+    log(pvrDEBUG1, "cPvrDevice::ProvidesChannel: /dev/video%d: %s is pre-tuned on another device", number, Channel->Name());
+    result = false;
+    }
   if (NeedsDetachReceivers)
     *NeedsDetachReceivers = needsDetachReceivers;
-  log(pvrDEBUG1, "cPvrDevice::ProvidesChannel: /dev/video%d (%s): Channel %d (%s) %3.2fMHz, -> %s",
+  dlog(pvrDEBUG1, "cPvrDevice::ProvidesChannel: /dev/video%d (%s): Channel %d (%s) %3.2fMHz, -> %s",
       number, CARDNAME[cardname], Channel->Number(), Channel->Name(), (double)Channel->Frequency() / 1000,
       result ? "true" : "false");
-  log(pvrDEBUG2, "cPvrDevice::ProvidesChannel: /dev/video%d: Receiving()=%s, needsDetachReceivers=%s, Priority=%d, hasPriority=%s",
+  dlog(pvrDEBUG2, "cPvrDevice::ProvidesChannel: /dev/video%d: Receiving()=%s, needsDetachReceivers=%s, Priority=%d, hasPriority=%s",
       number, Receiving(true) ? "true" : "false", needsDetachReceivers ? "true" : "false", Priority, hasPriority ? "true" : "false");
   return result;
 }
@@ -1146,6 +2030,8 @@ if a card/driver has unsupported controls, it returns false for this
 */
 bool cPvrDevice::ControlIdIsValid(__u32 ctrlid)
 {
+  if (driver == file)
+    return false;
   if (driver == hdpvr) {
     if (/*(ctrlid != V4L2_CID_BRIGHTNESS) // these controls seem to use other values for the HD PVR
       && (ctrlid != V4L2_CID_CONTRAST)    // than the other PVRs (ioctl returns "invalid argument")
@@ -1193,99 +2079,99 @@ int cPvrDevice::SetControlValue(__u32 control, __s32 Val)
   switch (control) {
   // picture properties
   case V4L2_CID_BRIGHTNESS:    ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.Brightness.queryctrl;
+                               query = &setup.Brightness.queryctrl;
                                break;
   case V4L2_CID_CONTRAST:      ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.Contrast.queryctrl;
+                               query = &setup.Contrast.queryctrl;
                                break;
   case V4L2_CID_SATURATION:    ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.Saturation.queryctrl;
+                               query = &setup.Saturation.queryctrl;
                                break;
   case V4L2_CID_HUE:           ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.Hue.queryctrl;
+                               query = &setup.Hue.queryctrl;
                                break;
   // Audio
   case V4L2_CID_AUDIO_VOLUME:  ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.AudioVolumeTVCommon.queryctrl;
+                               query = &setup.AudioVolumeTVCommon.queryctrl;
                                break;
   case V4L2_CID_AUDIO_MUTE:    ctrl_class = V4L2_CTRL_CLASS_USER;
-                               query = &PvrSetup.AudioMute.queryctrl;
+                               query = &setup.AudioMute.queryctrl;
                                break;
   case V4L2_CID_MPEG_AUDIO_L2_BITRATE:
-                               query = &PvrSetup.AudioBitrate.queryctrl;
+                               query = &setup.AudioBitrate.queryctrl;
                                break;
   case V4L2_CID_MPEG_AUDIO_SAMPLING_FREQ:
-                               query = &PvrSetup.AudioSampling.queryctrl;
+                               query = &setup.AudioSampling.queryctrl;
                                break;
   case V4L2_CID_MPEG_AUDIO_ENCODING:
                                if (driver == hdpvr)
-                                 query = &PvrSetup.HDPVR_AudioEncoding.queryctrl;
+                                 query = &setup.HDPVR_AudioEncoding.queryctrl;
                                else
-                                 query = &PvrSetup.AudioEncoding.queryctrl;
+                                 query = &setup.AudioEncoding.queryctrl;
                                break;
   // Video
   case V4L2_CID_MPEG_VIDEO_BITRATE:
-                               query = &PvrSetup.VideoBitrateTV.queryctrl;
+                               query = &setup.VideoBitrateTV.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_BITRATE_PEAK:
-                               query = &PvrSetup.VideoBitratePeak.queryctrl;
+                               query = &setup.VideoBitratePeak.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_ASPECT:
-                               query = &PvrSetup.AspectRatio.queryctrl;
+                               query = &setup.AspectRatio.queryctrl;
                                break;
   // MPEG
   case V4L2_CID_MPEG_STREAM_TYPE:
-                               query = &PvrSetup.StreamType.queryctrl;
+                               query = &setup.StreamType.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_BITRATE_MODE:
-                               query = &PvrSetup.BitrateMode.queryctrl;
+                               query = &setup.BitrateMode.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_B_FRAMES:
-                               query = &PvrSetup.BFrames.queryctrl;
+                               query = &setup.BFrames.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_GOP_SIZE:
-                               query = &PvrSetup.GopSize.queryctrl;
+                               query = &setup.GopSize.queryctrl;
                                break;
   case V4L2_CID_MPEG_VIDEO_GOP_CLOSURE:
-                               query = &PvrSetup.GopClosure.queryctrl;
+                               query = &setup.GopClosure.queryctrl;
                                break;
   // Video Filters
   case V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER_MODE:
-                               query = &PvrSetup.FilterSpatialMode.queryctrl;
+                               query = &setup.FilterSpatialMode.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER:
-                               query = &PvrSetup.FilterSpatial.queryctrl;
+                               query = &setup.FilterSpatial.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_SPATIAL_FILTER_TYPE:
-                               query = &PvrSetup.FilterLumaSpatialType.queryctrl;
+                               query = &setup.FilterLumaSpatialType.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_SPATIAL_FILTER_TYPE:
-                               query = &PvrSetup.FilterChromaSpatialType.queryctrl;
+                               query = &setup.FilterChromaSpatialType.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER_MODE:
-                               query = &PvrSetup.FilterTemporalMode.queryctrl;
+                               query = &setup.FilterTemporalMode.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER:
-                               query = &PvrSetup.FilterTemporal.queryctrl;
+                               query = &setup.FilterTemporal.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_MEDIAN_FILTER_TYPE:
-                               query = &PvrSetup.FilterMedianType.queryctrl;
+                               query = &setup.FilterMedianType.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_BOTTOM:
-                               query = &PvrSetup.FilterLumaMedianBottom.queryctrl;
+                               query = &setup.FilterLumaMedianBottom.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_TOP:
-                               query = &PvrSetup.FilterLumaMedianTop.queryctrl;
+                               query = &setup.FilterLumaMedianTop.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_BOTTOM:
-                               query = &PvrSetup.FilterChromaMedianBottom.queryctrl;
+                               query = &setup.FilterChromaMedianBottom.queryctrl;
                                break;
   case V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_TOP:
-                               query = &PvrSetup.FilterChromaMedianTop.queryctrl;
+                               query = &setup.FilterChromaMedianTop.queryctrl;
                                break;
   case V4L2_CID_MPEG_STREAM_VBI_FMT:
                                if (SupportsSlicedVBI)
-                                  query = &PvrSetup.VBIformat.queryctrl;
+                                  query = &setup.VBIformat.queryctrl;
                                break;
   default:
     log(pvrERROR, "SetControlValue(__u32 control, __s32 Val): ERROR: control %d not included in switch(control)", control);
@@ -1369,163 +2255,128 @@ bool cPvrDevice::QueryAllControls(void)
   int err = 0;
   log(pvrDEBUG1, "QueryAllControls");
 
-  PvrSetup.Brightness.ctrl_class                = V4L2_CTRL_CLASS_USER;
-  PvrSetup.Contrast.ctrl_class                  = V4L2_CTRL_CLASS_USER;
-  PvrSetup.Saturation.ctrl_class                = V4L2_CTRL_CLASS_USER;
-  PvrSetup.Hue.ctrl_class                       = V4L2_CTRL_CLASS_USER;
+  setup.Brightness.ctrl_class                = V4L2_CTRL_CLASS_USER;
+  setup.Contrast.ctrl_class                  = V4L2_CTRL_CLASS_USER;
+  setup.Saturation.ctrl_class                = V4L2_CTRL_CLASS_USER;
+  setup.Hue.ctrl_class                       = V4L2_CTRL_CLASS_USER;
   // Audio
-  PvrSetup.AudioVolumeTVCommon.ctrl_class       = V4L2_CTRL_CLASS_USER;
-  PvrSetup.AudioVolumeTVException.ctrl_class    = V4L2_CTRL_CLASS_USER;
-  PvrSetup.AudioVolumeFM.ctrl_class             = V4L2_CTRL_CLASS_USER;
-  PvrSetup.AudioMute.ctrl_class                 = V4L2_CTRL_CLASS_USER;
-  PvrSetup.AudioBitrate.ctrl_class              = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.AudioSampling.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.AudioEncoding.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.HDPVR_AudioEncoding.ctrl_class       = V4L2_CTRL_CLASS_MPEG;
+  setup.AudioVolumeTVCommon.ctrl_class       = V4L2_CTRL_CLASS_USER;
+  setup.AudioVolumeTVException.ctrl_class    = V4L2_CTRL_CLASS_USER;
+  setup.AudioVolumeFM.ctrl_class             = V4L2_CTRL_CLASS_USER;
+  setup.AudioMute.ctrl_class                 = V4L2_CTRL_CLASS_USER;
+  setup.AudioBitrate.ctrl_class              = V4L2_CTRL_CLASS_MPEG;
+  setup.AudioSampling.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
+  setup.AudioEncoding.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
+  setup.HDPVR_AudioEncoding.ctrl_class       = V4L2_CTRL_CLASS_MPEG;
   // Video
-  PvrSetup.VideoBitrateTV.ctrl_class            = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.VideoBitratePeak.ctrl_class          = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.AspectRatio.ctrl_class               = V4L2_CTRL_CLASS_MPEG;
+  setup.VideoBitrateTV.ctrl_class            = V4L2_CTRL_CLASS_MPEG;
+  setup.VideoBitratePeak.ctrl_class          = V4L2_CTRL_CLASS_MPEG;
+  setup.AspectRatio.ctrl_class               = V4L2_CTRL_CLASS_MPEG;
   // MPEG
-  PvrSetup.StreamType.ctrl_class                = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.BitrateMode.ctrl_class               = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.BFrames.ctrl_class                   = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.GopSize.ctrl_class                   = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.GopClosure.ctrl_class                = V4L2_CTRL_CLASS_MPEG;
+  setup.StreamType.ctrl_class                = V4L2_CTRL_CLASS_MPEG;
+  setup.BitrateMode.ctrl_class               = V4L2_CTRL_CLASS_MPEG;
+  setup.BFrames.ctrl_class                   = V4L2_CTRL_CLASS_MPEG;
+  setup.GopSize.ctrl_class                   = V4L2_CTRL_CLASS_MPEG;
+  setup.GopClosure.ctrl_class                = V4L2_CTRL_CLASS_MPEG;
   // Video Filters
-  PvrSetup.FilterSpatialMode.ctrl_class         = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterSpatial.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterLumaSpatialType.ctrl_class     = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterChromaSpatialType.ctrl_class   = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterTemporalMode.ctrl_class        = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterTemporal.ctrl_class            = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterMedianType.ctrl_class          = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterLumaMedianBottom.ctrl_class    = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterLumaMedianTop.ctrl_class       = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterChromaMedianBottom.ctrl_class  = V4L2_CTRL_CLASS_MPEG;
-  PvrSetup.FilterChromaMedianTop.ctrl_class     = V4L2_CTRL_CLASS_MPEG;
-
-  PvrSetup.Brightness.queryctrl.id              = V4L2_CID_BRIGHTNESS;
-  PvrSetup.Contrast.queryctrl.id                = V4L2_CID_CONTRAST;
-  PvrSetup.Saturation.queryctrl.id              = V4L2_CID_SATURATION;
-  PvrSetup.Hue.queryctrl.id                     = V4L2_CID_HUE;
+  setup.FilterSpatialMode.ctrl_class         = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterSpatial.ctrl_class             = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterLumaSpatialType.ctrl_class     = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterChromaSpatialType.ctrl_class   = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterTemporalMode.ctrl_class        = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterTemporal.ctrl_class            = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterMedianType.ctrl_class          = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterLumaMedianBottom.ctrl_class    = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterLumaMedianTop.ctrl_class       = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterChromaMedianBottom.ctrl_class  = V4L2_CTRL_CLASS_MPEG;
+  setup.FilterChromaMedianTop.ctrl_class     = V4L2_CTRL_CLASS_MPEG;
+
+  setup.Brightness.queryctrl.id              = V4L2_CID_BRIGHTNESS;
+  setup.Contrast.queryctrl.id                = V4L2_CID_CONTRAST;
+  setup.Saturation.queryctrl.id              = V4L2_CID_SATURATION;
+  setup.Hue.queryctrl.id                     = V4L2_CID_HUE;
   // Audio
-  PvrSetup.AudioVolumeTVCommon.queryctrl.id     = V4L2_CID_AUDIO_VOLUME;
-  PvrSetup.AudioVolumeTVException.queryctrl.id  = V4L2_CID_AUDIO_VOLUME;
-  PvrSetup.AudioVolumeFM.queryctrl.id           = V4L2_CID_AUDIO_VOLUME;
-  PvrSetup.AudioMute.queryctrl.id               = V4L2_CID_AUDIO_MUTE;
-  PvrSetup.AudioBitrate.queryctrl.id            = V4L2_CID_MPEG_AUDIO_L2_BITRATE;
-  PvrSetup.AudioSampling.queryctrl.id           = V4L2_CID_MPEG_AUDIO_SAMPLING_FREQ;
-  PvrSetup.AudioEncoding.queryctrl.id           = V4L2_CID_MPEG_AUDIO_ENCODING;
-  PvrSetup.HDPVR_AudioEncoding.queryctrl.id     = V4L2_CID_MPEG_AUDIO_ENCODING;
+  setup.AudioVolumeTVCommon.queryctrl.id     = V4L2_CID_AUDIO_VOLUME;
+  setup.AudioVolumeTVException.queryctrl.id  = V4L2_CID_AUDIO_VOLUME;
+  setup.AudioVolumeFM.queryctrl.id           = V4L2_CID_AUDIO_VOLUME;
+  setup.AudioMute.queryctrl.id               = V4L2_CID_AUDIO_MUTE;
+  setup.AudioBitrate.queryctrl.id            = V4L2_CID_MPEG_AUDIO_L2_BITRATE;
+  setup.AudioSampling.queryctrl.id           = V4L2_CID_MPEG_AUDIO_SAMPLING_FREQ;
+  setup.AudioEncoding.queryctrl.id           = V4L2_CID_MPEG_AUDIO_ENCODING;
+  setup.HDPVR_AudioEncoding.queryctrl.id     = V4L2_CID_MPEG_AUDIO_ENCODING;
   // Video
-  PvrSetup.VideoBitrateTV.queryctrl.id          = V4L2_CID_MPEG_VIDEO_BITRATE;
-  PvrSetup.VideoBitratePeak.queryctrl.id        = V4L2_CID_MPEG_VIDEO_BITRATE_PEAK;
-  PvrSetup.AspectRatio.queryctrl.id             = V4L2_CID_MPEG_VIDEO_ASPECT;
+  setup.VideoBitrateTV.queryctrl.id          = V4L2_CID_MPEG_VIDEO_BITRATE;
+  setup.VideoBitratePeak.queryctrl.id        = V4L2_CID_MPEG_VIDEO_BITRATE_PEAK;
+  setup.AspectRatio.queryctrl.id             = V4L2_CID_MPEG_VIDEO_ASPECT;
   // MPEG
-  PvrSetup.StreamType.queryctrl.id              = V4L2_CID_MPEG_STREAM_TYPE;
-  PvrSetup.BitrateMode.queryctrl.id             = V4L2_CID_MPEG_VIDEO_BITRATE_MODE;
-  PvrSetup.BFrames.queryctrl.id                 = V4L2_CID_MPEG_VIDEO_B_FRAMES;
-  PvrSetup.GopSize.queryctrl.id                 = V4L2_CID_MPEG_VIDEO_GOP_SIZE;
-  PvrSetup.GopClosure.queryctrl.id              = V4L2_CID_MPEG_VIDEO_GOP_CLOSURE;
+  setup.StreamType.queryctrl.id              = V4L2_CID_MPEG_STREAM_TYPE;
+  setup.BitrateMode.queryctrl.id             = V4L2_CID_MPEG_VIDEO_BITRATE_MODE;
+  setup.BFrames.queryctrl.id                 = V4L2_CID_MPEG_VIDEO_B_FRAMES;
+  setup.GopSize.queryctrl.id                 = V4L2_CID_MPEG_VIDEO_GOP_SIZE;
+  setup.GopClosure.queryctrl.id              = V4L2_CID_MPEG_VIDEO_GOP_CLOSURE;
   // Video Filters
-  PvrSetup.FilterSpatialMode.queryctrl.id       = V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER_MODE;
-  PvrSetup.FilterSpatial.queryctrl.id           = V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER;
-  PvrSetup.FilterLumaSpatialType.queryctrl.id   = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_SPATIAL_FILTER_TYPE;
-  PvrSetup.FilterChromaSpatialType.queryctrl.id = V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_SPATIAL_FILTER_TYPE;
-  PvrSetup.FilterTemporalMode.queryctrl.id      = V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER_MODE;
-  PvrSetup.FilterTemporal.queryctrl.id          = V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER;
-  PvrSetup.FilterMedianType.queryctrl.id        = V4L2_CID_MPEG_CX2341X_VIDEO_MEDIAN_FILTER_TYPE;
-  PvrSetup.FilterLumaMedianBottom.queryctrl.id  = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_BOTTOM;
-  PvrSetup.FilterLumaMedianTop.queryctrl.id     = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_TOP;
-  PvrSetup.FilterChromaMedianBottom.queryctrl.id= V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_BOTTOM;
-  PvrSetup.FilterChromaMedianTop.queryctrl.id   = V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_TOP;
+  setup.FilterSpatialMode.queryctrl.id       = V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER_MODE;
+  setup.FilterSpatial.queryctrl.id           = V4L2_CID_MPEG_CX2341X_VIDEO_SPATIAL_FILTER;
+  setup.FilterLumaSpatialType.queryctrl.id   = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_SPATIAL_FILTER_TYPE;
+  setup.FilterChromaSpatialType.queryctrl.id = V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_SPATIAL_FILTER_TYPE;
+  setup.FilterTemporalMode.queryctrl.id      = V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER_MODE;
+  setup.FilterTemporal.queryctrl.id          = V4L2_CID_MPEG_CX2341X_VIDEO_TEMPORAL_FILTER;
+  setup.FilterMedianType.queryctrl.id        = V4L2_CID_MPEG_CX2341X_VIDEO_MEDIAN_FILTER_TYPE;
+  setup.FilterLumaMedianBottom.queryctrl.id  = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_BOTTOM;
+  setup.FilterLumaMedianTop.queryctrl.id     = V4L2_CID_MPEG_CX2341X_VIDEO_LUMA_MEDIAN_FILTER_TOP;
+  setup.FilterChromaMedianBottom.queryctrl.id= V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_BOTTOM;
+  setup.FilterChromaMedianTop.queryctrl.id   = V4L2_CID_MPEG_CX2341X_VIDEO_CHROMA_MEDIAN_FILTER_TOP;
   if (SupportsSlicedVBI)
-     PvrSetup.VBIformat.queryctrl.id            = V4L2_CID_MPEG_STREAM_VBI_FMT;
+     setup.VBIformat.queryctrl.id            = V4L2_CID_MPEG_STREAM_VBI_FMT;
   /* now quering min, max, default */
   // picture properties
-  err += QueryControl(&PvrSetup.Brightness);
-  err += QueryControl(&PvrSetup.Contrast);
-  err += QueryControl(&PvrSetup.Saturation);
-  err += QueryControl(&PvrSetup.Hue);
+  err += QueryControl(&setup.Brightness);
+  err += QueryControl(&setup.Contrast);
+  err += QueryControl(&setup.Saturation);
+  err += QueryControl(&setup.Hue);
   // Audio
-  err += QueryControl(&PvrSetup.AudioVolumeTVCommon);
-  err += QueryControl(&PvrSetup.AudioVolumeTVException);
-  err += QueryControl(&PvrSetup.AudioVolumeFM);
-  err += QueryControl(&PvrSetup.AudioMute);
-  err += QueryControl(&PvrSetup.AudioBitrate);
-  err += QueryControl(&PvrSetup.AudioSampling);
+  err += QueryControl(&setup.AudioVolumeTVCommon);
+  err += QueryControl(&setup.AudioVolumeTVException);
+  err += QueryControl(&setup.AudioVolumeFM);
+  err += QueryControl(&setup.AudioMute);
+  err += QueryControl(&setup.AudioBitrate);
+  err += QueryControl(&setup.AudioSampling);
   if (driver == hdpvr)
-    err += QueryControl(&PvrSetup.HDPVR_AudioEncoding);
+    err += QueryControl(&setup.HDPVR_AudioEncoding);
   else
-    err += QueryControl(&PvrSetup.AudioEncoding);
+    err += QueryControl(&setup.AudioEncoding);
   // Video
-  err += QueryControl(&PvrSetup.VideoBitrateTV);
-  err += QueryControl(&PvrSetup.VideoBitratePeak);
-  err += QueryControl(&PvrSetup.AspectRatio);
+  err += QueryControl(&setup.VideoBitrateTV);
+  err += QueryControl(&setup.VideoBitratePeak);
+  err += QueryControl(&setup.AspectRatio);
   // MPEG
-  err += QueryControl(&PvrSetup.StreamType);
-  err += QueryControl(&PvrSetup.BitrateMode);
-  err += QueryControl(&PvrSetup.BFrames);
-  err += QueryControl(&PvrSetup.GopSize);
-  err += QueryControl(&PvrSetup.GopClosure);
+  err += QueryControl(&setup.StreamType);
+  err += QueryControl(&setup.BitrateMode);
+  err += QueryControl(&setup.BFrames);
+  err += QueryControl(&setup.GopSize);
+  err += QueryControl(&setup.GopClosure);
   // Video Filters
-  err += QueryControl(&PvrSetup.FilterSpatialMode);
-  err += QueryControl(&PvrSetup.FilterSpatial);
-  err += QueryControl(&PvrSetup.FilterLumaSpatialType);
-  err += QueryControl(&PvrSetup.FilterChromaSpatialType);
-  err += QueryControl(&PvrSetup.FilterTemporalMode);
-  err += QueryControl(&PvrSetup.FilterTemporal);
-  err += QueryControl(&PvrSetup.FilterMedianType);
-  err += QueryControl(&PvrSetup.FilterLumaMedianBottom);
-  err += QueryControl(&PvrSetup.FilterLumaMedianTop);
-  err += QueryControl(&PvrSetup.FilterChromaMedianBottom);
-  err += QueryControl(&PvrSetup.FilterChromaMedianTop);
+  err += QueryControl(&setup.FilterSpatialMode);
+  err += QueryControl(&setup.FilterSpatial);
+  err += QueryControl(&setup.FilterLumaSpatialType);
+  err += QueryControl(&setup.FilterChromaSpatialType);
+  err += QueryControl(&setup.FilterTemporalMode);
+  err += QueryControl(&setup.FilterTemporal);
+  err += QueryControl(&setup.FilterMedianType);
+  err += QueryControl(&setup.FilterLumaMedianBottom);
+  err += QueryControl(&setup.FilterLumaMedianTop);
+  err += QueryControl(&setup.FilterChromaMedianBottom);
+  err += QueryControl(&setup.FilterChromaMedianTop);
   if (SupportsSlicedVBI)
-     err += QueryControl(&PvrSetup.VBIformat);
+     err += QueryControl(&setup.VBIformat);
   if (err)
     return false;
 
-  // The following code checks wether a valSet.value is 
-  // INVALID_VALUE and if so -> set it to its queryctrl.default_value.
-  // The macro INIT(v) is a abbreviation for the 'if .. then' comparison.
-  #define INIT(v) if (v.value == INVALID_VALUE) v.value=v.queryctrl.default_value
-  // picture properties
-  INIT(PvrSetup.Brightness);
-  INIT(PvrSetup.Contrast);
-  INIT(PvrSetup.Saturation);
-  INIT(PvrSetup.Hue);
-  // Audio
-  if (PvrSetup.AudioVolumeTVCommon.value == INVALID_VALUE)
-    PvrSetup.AudioVolumeTVCommon.value = (int)(0.95 * PvrSetup.AudioVolumeTVCommon.queryctrl.maximum);
-  if (PvrSetup.AudioVolumeTVException.value == INVALID_VALUE)
-    PvrSetup.AudioVolumeTVException.value = (int)(0.95 * PvrSetup.AudioVolumeTVException.queryctrl.maximum);
-  if (PvrSetup.AudioVolumeFM.value == INVALID_VALUE)
-    PvrSetup.AudioVolumeFM.value = PvrSetup.AudioVolumeFM.queryctrl.maximum;
-  INIT(PvrSetup.AudioBitrate);
-  INIT(PvrSetup.AudioSampling);
-  if (driver == hdpvr)
-    INIT(PvrSetup.HDPVR_AudioEncoding);
-  // Video
-  INIT(PvrSetup.VideoBitrateTV);
-  INIT(PvrSetup.AspectRatio);
-  // MPEG
-  INIT(PvrSetup.BitrateMode);
-  INIT(PvrSetup.BFrames);
-  INIT(PvrSetup.GopSize);
-  INIT(PvrSetup.GopClosure);
-  // Video Filters
-  INIT(PvrSetup.FilterSpatialMode);
-  INIT(PvrSetup.FilterSpatial);
-  INIT(PvrSetup.FilterLumaSpatialType);
-  INIT(PvrSetup.FilterChromaSpatialType);
-  INIT(PvrSetup.FilterTemporalMode);
-  INIT(PvrSetup.FilterTemporal);
-  INIT(PvrSetup.FilterMedianType);
-  INIT(PvrSetup.FilterLumaMedianBottom);
-  INIT(PvrSetup.FilterLumaMedianTop);
-  INIT(PvrSetup.FilterChromaMedianBottom);
-  INIT(PvrSetup.FilterChromaMedianTop);
+  // values which are still INVALID_VALUE get the default of the driver
+  setup.InitValues(driver == hdpvr);
+  // the setup menu edits the common values with the ranges of the first device
+  PvrSetup.TakeControls(setup, true);
+  PvrSetup.InitValues(driver == hdpvr);
   return true;
 }
 
@@ -6,6 +6,14 @@ typedef enum { /* enumeration with encoder states */
   eStart,
 } eEncState;
 
+typedef enum { /* states of the channel switch done by cPvrTuneThread */
+  eTuneIdle,      // nothing requested since the device was created
+  eTunePending,   // SetChannelDevice recorded a new channel
+  eTuneSwitching, // the tune thread is programming the hardware
+  eTuneDone,      // hardware is set up, OpenDvr may start the encoder
+  eTuneFailed,    // switching failed, OpenDvr will fail
+} eTuneState;
+
 typedef enum {
   eTelevision,
   eRadio,
@@ -19,6 +27,7 @@ typedef enum {
   eComposite3,
   eComposite4,
   eComponent,
+  eFile,
   eExternalInput
 } eInputType;
 
@@ -29,6 +38,7 @@ typedef enum {
   pvrusb2,
   cx88_blackbird,
   hdpvr,
+  file,
 } eV4l2Driver;
 
 typedef enum {
@@ -47,15 +57,22 @@ typedef enum {
 } eV4l2CardName;
 
 class cPvrReadThread;
+class cPvrTuneThread;
+class cPvrExternHelper;
 
 class cPvrDevice : public cDevice {
   friend class cPvrReadThread;
+  friend class cPvrRemuxThread;
+  friend class cPvrTuneThread;
+  friend class cPvrBitrateGovernor;
+  friend class cPvrDriftMonitor;
 #ifdef __DYNAMIC_DEVICE_PROBE
   friend class cPvrDeviceProbe;
 #endif
 private:
   static bool Probe(int DeviceNumber);
   static cString externChannelSwitchScript;
+  static cString externChannelSwitchHelper;
   static int VBIDeviceCount;
 
 public:
@@ -64,6 +81,9 @@ public:
   static void ReInitAll(void);
   static int Count();
   static cPvrDevice * Get(int index);
+  static void ReleaseIdleBuffers(void);
+  static void PreTune(void);
+  static int TotalBufferMemory(void);
 
 private:
   int index;
@@ -74,7 +94,7 @@ private:
   int v4l2_dev;
   int mpeg_dev;
   cString radio_devname;
-  int inputs[12];
+  int inputs[13];
   int numInputs;
   int vpid;
   int apid;
@@ -109,10 +129,88 @@ private:
   bool pvrusb2_ready;
   eV4l2Driver driver;
   eV4l2CardName cardname;
-  cRingBufferLinear *tsBuffer;
+  cRingBufferLinear *tsBuffer; // allocated by OpenDvr, released when idle
+  int tsBufferSize;
+  bool tsBufferInUse;          // between OpenDvr and CloseDvr, protected by stateMutex
+  time_t tsBufferIdleSince;
+  int readBufferSize;          // of the running read thread
   int tsBufferPrefill;
+  void AllocateBuffer(void);
   cPvrReadThread *readThread;
+  cPvrTuneThread *tuneThread;
+  cPvrExternHelper *externHelper; // only used by the tune thread
+  eTuneState tuneState;
+  int tuneGeneration;
+  mutable cMutex stateMutex;   // protects dvrOpen, pvrusb2_ready, tuneState and the new* values
+  mutable cCondVar stateCond;  // signalled whenever one of them changes
+  // signal sampler, run by the tune thread
+  int signalStrength;                // last sample in percent, -1 = unknown
+  mutable uint64_t signalLastRequest; // cTimeMs::Now() of the last SignalStrength call
+  uint64_t signalNextSample;         // only used by the tune thread
+  bool signalForce;                  // protected by stateMutex, sample after a switch
+  mutable bool signalSampling;       // protected by stateMutex, VIDIOC_G_TUNER running
+  int fdChanges;                     // protected by stateMutex, v4l2_fd is being closed or reopened
+  void BeginFdChange(void);
+  void EndFdChange(void);
+  bool ReadSignalStrength(int &Strength) const;
+  enum { kSignalIdleMs = 5000 }; // pause sampling if SignalStrength wasn't called for so long
   cPvrSectionHandler sectionHandler;
+  cPvrSetup setup;     // PvrSetup with the settings of this card and its own control ranges
+  bool reInitPending;  // protected by stateMutex, ReInitAll wants ReInit again at the next OpenDvr
+  bool setupDeferred;  // protected by stateMutex, LoadSetup kept the settings of the running read thread
+  void LoadSetup(void);
+  bool liveView;       // LiveView of the last SetChannelDevice
+  cPvrEncoderProfile encoderProfile; // values last sent to the encoder
+  void ApplyEncoderProfile(bool Live);
+  void ApplyEncoderControl(int &Applied, int Value, valSet &vs);
+  cPvrDriftMonitor drift; // fed by the read thread
+  cPvrQualityMonitor quality; // too
+  int watchdogIncidents;   // capture watchdog of the read thread
+  int watchdogRecoveries;
+  int watchdogLastMs;      // time to recovery of the last incident
+  int recoveryRequest;     // protected by stateMutex: watchdog step for the tune thread, 0 = none
+  bool recovering;         // protected by stateMutex: the tune thread is doing recoveryRequest
+  bool captureFailed;      // protected by stateMutex: the read thread gave up, until the next OpenDvr
+  bool profileLive;        // Live of the last ApplyEncoderProfile
+  int bitrateLevel;        // protected by stateMutex: BitrateGovernor step the encoder runs with, -1 = refused
+  int bitrateLevelWanted;  // protected by stateMutex: step the governor asked for
+  int BitrateLevel(void) const;
+  void RequestBitrateLevel(int Level);
+  bool ApplyBitrateLevel(int Level);
+  void Recover(void);
+  void TearDownFailed(void);
+  cPvrStreamStats stats;   // for the statistics page, written by the read thread
+  uint64_t zapStart;       // SetChannelDevice with LiveView, 0 = delivering
+  int lastZapMs;
+  int ioctlRetries;
+  void InitVideoDevice(void);
+  void InitFileDevice(void);
+  bool fileIsFifo;
+  bool OpenFile(const char *FileName);
+  // CloseDvr may leave encoder and reader running for EncoderLingerMs
+  bool lingering;        // protected by stateMutex
+  bool lingerStopping;   // EndLinger is stopping the encoder
+  uint64_t lingerUntil;
+  bool discardOutput;    // the reader drops the TS packets
+  bool gopAlign;         // GopAlign: the reader waits for the next entry point
+  void EndLinger(void);
+  void StartEncoder(int LinesPerFrame, bool Live);
+  // PreTune: idle devices encode the channels likely to be watched next
+  bool preTuned;         // lingering on a channel chosen by PreTune()
+  bool preTuneRequested; // the tune thread starts the encoder after switching
+  bool preTunePending;   // PreTune() chose preTuneChannel, the tune thread switches to it
+  cChannel preTuneChannel;
+  void StartPreTune(void);
+  void StartPreTuned(void);
+  bool PreTunedElsewhere(const cChannel *Channel) const;
+  void QueueSwitch(const cChannel *Channel, int Input, uint64_t Norm, int LinesPerFrame, eInputType InputType);
+  enum { kMaxWatched = 8 };
+  struct tWatched {
+    int number;
+    int count;
+  };
+  static tWatched watched[kMaxWatched];
+  static void RecordWatched(int ChannelNumber);
 
 protected:
   virtual bool SetChannelDevice(const cChannel *Channel, bool LiveView);
@@ -123,7 +221,7 @@ protected:
 #endif
   virtual bool OpenDvr(void);
   virtual void CloseDvr(void);
-  void         ResetBuffering();
+  void         ResetBuffering(bool Live = false);
   bool         IsBuffering();
   virtual bool GetTSPacket(uchar *&Data);
 public:
@@ -140,13 +238,28 @@ public:
   virtual bool MaySwitchTransponder(const cChannel *Channel) const;
   bool ParseChannel(const cChannel *Channel, int *input, uint64_t *norm, int *LinesPerFrame, int *card,
                     eInputType *inputType, int *apid, int *vpid, int *tpid) const;
-  int  ReOpen(void);
+  int  ReOpen(int Retries = 5);
+  void Reinitialize(const cChannel &Channel);
+  void RequestRecovery(int Step);
+  void CaptureFailed(void);
   void ReInit(void);
+  cPvrSetup *DeviceSetup(void);
+  const char *GetBusID(void) const;
+  void GetStats(tPvrStats &Stats, bool Signal = true);
+  void GetTotals(tPvrTotals &Totals) const { stats.GetTotals(Totals); }
+  int  Sections(void) const { return sectionHandler.Sections(); }
+  int  IoctlRetries(void) const { return __atomic_load_n(&ioctlRetries, __ATOMIC_RELAXED); }
+  static void IoctlRetried(int Fd);
+  int  Number(void) const { return number; }
+  const char *CardName(void) const;
+  int  BufferMemory(void) const { return (tsBuffer ? tsBufferSize : 0) + (readThreadRunning ? readBufferSize : 0); }
   void Stop(void);
   void StopReadThread(void);
+  void StopTuneThread(void);
   void GetStandard(void);
   void TurnOffSlicedVBI(void);
   bool Tune(int frequency);
+  bool SwitchToChannel(const cChannel &Channel, eInputType inputType, int input, uint64_t norm, int frequency);
   bool SetInput(int input);
   bool SetAudioInput(int input);
   bool SetVideoNorm(uint64_t norm);
@@ -0,0 +1,166 @@
+#include "common.h"
+#include <time.h>
+
+#define PTS_MASK       0x1FFFFFFFFull  // 33 bits
+#define SETTLE_SAMPLES 250             // audio frames before the A/V baseline is taken
+#define MIN_SCR_SPAN   (10 * 90000)    // measure the SCR rate over at least 10 s
+
+cPvrDriftMonitor::cPvrDriftMonitor(cPvrDevice *Device)
+: device(Device)
+{
+  Reset();
+}
+
+void cPvrDriftMonitor::Reset(void)
+{
+  cMutexLock lock(&mutex);
+  scrStart = timeStart = scrLast = timeLast = 0;
+  delay = jitter = 0;
+  delaySamples = 0;
+  haveScr = false;
+  videoPts = -1;
+  offset = baseline = 0;
+  offsetSamples = 0;
+  correction = 0;
+  memset(&stats, 0, sizeof(stats));
+}
+
+/*
+monotonic clock in 90 kHz ticks
+*/
+uint64_t cPvrDriftMonitor::Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 90000 + ts.tv_nsec / (1000000000 / 90000);
+}
+
+/*
+a - b, taking the 33 bit wrap around into account
+*/
+int64_t cPvrDriftMonitor::PtsDiff(uint64_t a, uint64_t b)
+{
+  int64_t d = (a - b) & PTS_MASK;
+  if (d > (int64_t)(PTS_MASK >> 1))
+     d -= PTS_MASK + 1;
+  return d;
+}
+
+int64_t cPvrDriftMonitor::GetPts(const uint8_t *Pes)
+{
+  if (((Pes[6] & 0xC0) != 0x80) || !(Pes[7] & 0x80) || (Pes[8] < 5))
+     return -1; // no MPEG-2 PES header or no PTS
+  const uint8_t *p = Pes + 9;
+  return ((int64_t)(p[0] & 0x0E) << 29) | (p[1] << 22) | ((p[2] & 0xFE) << 14) | (p[3] << 7) | (p[4] >> 1);
+}
+
+void cPvrDriftMonitor::SetPts(uint8_t *Pes, uint64_t Pts)
+{
+  uint8_t *p = Pes + 9;
+  p[0] = (p[0] & 0xF1) | ((Pts >> 29) & 0x0E);
+  p[1] = (Pts >> 22) & 0xFF;
+  p[2] = ((Pts >> 14) & 0xFE) | 0x01;
+  p[3] = (Pts >> 7) & 0xFF;
+  p[4] = ((Pts << 1) & 0xFE) | 0x01;
+}
+
+/*
+called for each pack header of the program stream
+*/
+void cPvrDriftMonitor::Scr(uint64_t Scr)
+{
+  uint64_t now = Now();
+  if (!haveScr) {
+     scrStart = scrLast = Scr;
+     timeStart = timeLast = now;
+     haveScr = true;
+     return;
+     }
+  int64_t dscr = PtsDiff(Scr, scrLast);
+  if ((dscr < 0) || (dscr > 90000)) { // discontinuity, start again
+     scrStart = Scr;
+     timeStart = now;
+     delay = jitter = 0;
+     delaySamples = 0;
+     }
+  scrLast = Scr;
+  timeLast = now;
+  Update();
+}
+
+/*
+called for each complete PES packet before it is packed into TS
+*/
+void cPvrDriftMonitor::Pes(uint8_t *Data, uint32_t Length)
+{
+  if (Length < 14)
+     return;
+  uint8_t stream_id = Data[3];
+  if ((stream_id < 0xC0) || (stream_id > 0xEF))
+     return;
+  int64_t pts = GetPts(Data);
+  if (pts < 0)
+     return;
+  if (stream_id >= 0xE0) {
+     videoPts = pts;
+     if (!haveScr)
+        return;
+     int64_t d = PtsDiff(pts, scrLast); // how far the decoder is ahead of the mux
+     if ((d < -5 * 90000) || (d > 5 * 90000))
+        return;
+     if (!delaySamples++)
+        delay = d << 4;
+     else {
+        int64_t deviation = d - (delay >> 4);
+        jitter += ((deviation < 0 ? -deviation : deviation) - jitter) / 16;
+        delay += deviation; // EMA over 16 pictures
+        }
+     return;
+     }
+  if (videoPts < 0)
+     return;
+  int64_t d = PtsDiff(pts, videoPts);
+  if ((d < -5 * 90000) || (d > 5 * 90000)) // not the same time base
+     return;
+  if (!offsetSamples)
+     offset = d << 4;
+  else
+     offset += d - (offset >> 4); // EMA over 16 audio frames
+  if (++offsetSamples == SETTLE_SAMPLES)
+     baseline = offset;
+  cPvrSetup &setup = device->setup;
+  if (!setup.DriftCorrection || (offsetSamples < SETTLE_SAMPLES))
+     return;
+  int64_t drift = (offset - baseline) >> 4;
+  int64_t max = (int64_t)setup.DriftCorrectionMaxMs * 90;
+  if ((drift - correction > max) || (correction - drift > max)) {
+     log(pvrINFO, "cPvrDriftMonitor: audio drifted by %d ms on /dev/video%d, correcting",
+         (int)(drift / 90), device->number);
+     correction = drift;
+     }
+  if (correction)
+     SetPts(Data, (pts - correction) & PTS_MASK);
+}
+
+void cPvrDriftMonitor::Update(void)
+{
+  if (timer.Elapsed() < 1000)
+     return;
+  timer.Set();
+  tPvrDriftStats s;
+  int64_t dtime = timeLast - timeStart;
+  int64_t dscr = PtsDiff(scrLast, scrStart);
+  s.scrPpm = (dtime >= MIN_SCR_SPAN) ? (int)((dscr - dtime) * 1000000 / dtime) : 0;
+  s.avOffsetMs = offsetSamples ? (int)((offset >> 4) / 90) : 0;
+  s.avDriftMs = (offsetSamples >= SETTLE_SAMPLES) ? (int)(((offset - baseline) >> 4) / 90) : 0;
+  s.ptsJitterUs = (int)(jitter * 1000 / 90);
+  s.correctionMs = (int)(correction / 90);
+  cMutexLock lock(&mutex);
+  stats = s;
+}
+
+void cPvrDriftMonitor::GetStats(tPvrDriftStats &Stats)
+{
+  cMutexLock lock(&mutex);
+  Stats = stats;
+}
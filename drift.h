@@ -0,0 +1,54 @@
+#ifndef _PVRINPUT_DRIFT_H_
+#define _PVRINPUT_DRIFT_H_
+
+class cPvrDevice;
+
+struct tPvrDriftStats {
+  int scrPpm;         // SCR rate against CLOCK_MONOTONIC, parts per million
+  int avOffsetMs;     // audio PTS - video PTS, averaged
+  int avDriftMs;      // change of avOffsetMs since the start of the stream
+  int ptsJitterUs;    // averaged deviation of video PTS - SCR from its mean
+  int correctionMs;   // currently subtracted from audio PTS
+};
+
+/*
+Watches the timestamps of the program stream: the SCR against the monotonic
+clock, the offset between audio and video PTS and the jitter of the video PTS
+against the SCR. The rate is taken over at least ten seconds, as the SCRs
+arrive in batches of one read().
+With DriftCorrection the audio PTS is shifted in steps to keep the A/V offset
+within DriftCorrectionMaxMs of the offset at the start of the stream.
+*/
+class cPvrDriftMonitor {
+private:
+  cPvrDevice *device;
+  uint64_t scrStart;    // first SCR and its arrival time
+  uint64_t timeStart;
+  uint64_t scrLast;
+  uint64_t timeLast;
+  int64_t delay;        // EMA of video PTS - SCR, in 1/90 ms << 4
+  int64_t jitter;       // EMA of its deviation, in 1/90 ms
+  int delaySamples;
+  bool haveScr;
+  int64_t videoPts;     // last video PTS, -1 = none yet
+  int64_t offset;       // EMA of audio - video PTS, in 1/90 ms << 4
+  int64_t baseline;     // offset after the settling time
+  int offsetSamples;
+  int64_t correction;   // in 1/90 ms
+  cTimeMs timer;
+  cMutex mutex;
+  tPvrDriftStats stats;
+  static uint64_t Now(void);
+  static int64_t PtsDiff(uint64_t a, uint64_t b);
+  static int64_t GetPts(const uint8_t *Pes);
+  static void SetPts(uint8_t *Pes, uint64_t Pts);
+  void Update(void);
+public:
+  cPvrDriftMonitor(cPvrDevice *Device);
+  void Reset(void);
+  void Scr(uint64_t Scr);
+  void Pes(uint8_t *Data, uint32_t Length);
+  void GetStats(tPvrDriftStats &Stats);
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "common.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+cPvrExternHelper::cPvrExternHelper(const char *Command, int Number)
+: command(Command),
+  number(Number),
+  pid(-1),
+  toHelper(-1),
+  fromHelper(-1),
+  lineLength(0)
+{
+  line[0] = 0;
+}
+
+cPvrExternHelper::~cPvrExternHelper(void)
+{
+  Stop();
+}
+
+bool cPvrExternHelper::Start(void)
+{
+  int in[2], out[2];
+  if (pipe(in) < 0)
+     return false;
+  if (pipe(out) < 0) {
+     close(in[0]);
+     close(in[1]);
+     return false;
+     }
+  pid = fork();
+  if (pid < 0) {
+     log(pvrERROR, "cPvrExternHelper: fork for %s failed: %d:%s", *command, errno, strerror(errno));
+     close(in[0]); close(in[1]);
+     close(out[0]); close(out[1]);
+     return false;
+     }
+  if (pid == 0) {
+     // child: stdin/stdout are the pipes, don't leak vdr's file descriptors
+     dup2(in[0], STDIN_FILENO);
+     dup2(out[1], STDOUT_FILENO);
+     int maxfd = getdtablesize();
+     for (int fd = STDERR_FILENO + 1; fd < maxfd; fd++)
+         close(fd);
+     char card[16];
+     snprintf(card, sizeof(card), "%d", number);
+     execl(*command, *command, card, (char *)NULL);
+     _exit(127);
+     }
+  close(in[0]);
+  close(out[1]);
+  toHelper = in[1];
+  fromHelper = out[0];
+  fcntl(toHelper, F_SETFD, FD_CLOEXEC);
+  fcntl(fromHelper, F_SETFD, FD_CLOEXEC);
+  lineLength = 0;
+  log(pvrINFO, "cPvrExternHelper: started %s for /dev/video%d (pid %d)", *command, number, pid);
+  return true;
+}
+
+void cPvrExternHelper::Stop(void)
+{
+  if (toHelper >= 0) {
+     close(toHelper); // the helper sees EOF on stdin and should exit
+     toHelper = -1;
+     }
+  if (fromHelper >= 0) {
+     close(fromHelper);
+     fromHelper = -1;
+     }
+  if (pid > 0) {
+     int i;
+     for (i = 0; i < 10; i++) {
+         if (waitpid(pid, NULL, WNOHANG) != 0)
+            break;
+         if (i == 0)
+            kill(pid, SIGTERM);
+         usleep(50000);
+         }
+     if (i == 10) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        }
+     log(pvrDEBUG1, "cPvrExternHelper: stopped %s for /dev/video%d", *command, number);
+     pid = -1;
+     }
+}
+
+/*
+reads one line from the helper into 'line'.
+returns 1 on a complete line, 0 on timeout and -1 if the helper is gone
+*/
+int cPvrExternHelper::ReadLine(int TimeoutMs)
+{
+  uint64_t deadline = cTimeMs::Now() + TimeoutMs;
+  for (;;) {
+    char *nl = (char *)memchr(line, '\n', lineLength);
+    if (nl) {
+       *nl = 0;
+       return 1;
+       }
+    if (lineLength >= (int)sizeof(line) - 1) {
+       line[lineLength] = 0; // overlong line, take it as it is
+       lineLength = 0;
+       return 1;
+       }
+    int remaining = max((int)(deadline - cTimeMs::Now()), 0);
+    struct pollfd pfd = { fromHelper, POLLIN, 0 };
+    int r = poll(&pfd, 1, remaining);
+    if (r < 0) {
+       if (errno == EINTR)
+          continue;
+       return -1;
+       }
+    if (r == 0)
+       return 0;
+    int n = read(fromHelper, line + lineLength, sizeof(line) - 1 - lineLength);
+    if (n < 0) {
+       if ((errno == EINTR) || (errno == EAGAIN))
+          continue;
+       return -1;
+       }
+    if (n == 0)
+       return -1;
+    lineLength += n;
+    }
+}
+
+void cPvrExternHelper::DiscardLine(void)
+{
+  int len = strlen(line) + 1;
+  if (len >= lineLength)
+     lineLength = 0;
+  else {
+     memmove(line, line + len, lineLength - len);
+     lineLength -= len;
+     }
+}
+
+bool cPvrExternHelper::Switch(const cChannel &Channel, int TimeoutMs)
+{
+  cString cmd = cString::sprintf("SWITCH %d %d %d %d\n", Channel.Sid(), Channel.Number(), number, Channel.Frequency());
+  for (int attempt = 0; attempt < 2; attempt++) {
+      if ((pid <= 0) && !Start())
+         return false;
+      // forget answers of an earlier switch which timed out
+      while (ReadLine(0) == 1)
+        DiscardLine();
+      if (safe_write(toHelper, *cmd, strlen(*cmd)) < 0) {
+         log(pvrERROR, "cPvrExternHelper: write to %s failed: %d:%s, restarting", *command, errno, strerror(errno));
+         Stop();
+         continue;
+         }
+      for (;;) {
+        int r = ReadLine(TimeoutMs);
+        if (r == 0) {
+           log(pvrERROR, "cPvrExternHelper: no answer from %s within %d ms", *command, TimeoutMs);
+           return true; // like the old blind sleep: go on and hope the receiver is there
+           }
+        if (r < 0) {
+           log(pvrERROR, "cPvrExternHelper: %s on /dev/video%d exited, restarting", *command, number);
+           Stop();
+           break;
+           }
+        if (startswith(line, "READY")) {
+           DiscardLine();
+           return true;
+           }
+        if (startswith(line, "ERROR")) {
+           log(pvrERROR, "cPvrExternHelper: %s: %s", *command, line);
+           DiscardLine();
+           return false;
+           }
+        log(pvrDEBUG2, "cPvrExternHelper: %s: %s", *command, line);
+        DiscardLine();
+        }
+      }
+  return false;
+}
@@ -0,0 +1,30 @@
+#ifndef _PVRINPUT_EXTERNHELPER_H_
+#define _PVRINPUT_EXTERNHELPER_H_
+
+/*
+A long running replacement for externchannelswitch.sh. The helper is started
+once per device and gets one line per channel switch on stdin:
+  SWITCH <sid> <vdr channel number> <card number> <frequency>
+It answers with "READY" when the receiver shows the new channel or with
+"ERROR <text>". Other lines are logged and ignored.
+*/
+class cPvrExternHelper {
+private:
+  cString command;
+  int number;
+  pid_t pid;
+  int toHelper;      // write end of the helper's stdin
+  int fromHelper;    // read end of the helper's stdout
+  char line[256];
+  int lineLength;
+  bool Start(void);
+  void Stop(void);
+  int ReadLine(int TimeoutMs);
+  void DiscardLine(void);
+public:
+  cPvrExternHelper(const char *Command, int Number);
+  ~cPvrExternHelper(void);
+  bool Switch(const cChannel &Channel, int TimeoutMs);
+};
+
+#endif
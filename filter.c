@@ -40,6 +40,7 @@ int  cPvrSectionFilter::GetHandle() const
 }
 
 cPvrSectionHandler::cPvrSectionHandler()
+: sections(0)
 {
 }
 
@@ -91,6 +92,10 @@ void  cPvrSectionHandler::ProcessTSPacket(const u_char *Data)
            written = write(filter->handle[1], Data + section_start, section_len);
            if (written != section_len)
               log(pvrERROR, "cPvrSectionHandler::ProcessTSPacket(): written only %d instead of %d", written, section_len);
+           else {
+              PVR_PROBE3(section, pid, tid, section_len);
+              __atomic_store_n(&sections, sections + 1, __ATOMIC_RELAXED);
+              }
            }
         filter = filters.Next(filter);
         }
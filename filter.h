@@ -18,6 +18,7 @@ public:
 class cPvrSectionHandler {
 private:
   cList<cPvrSectionFilter>  filters;
+  int sections;   // written to the filters
 
 public:
   cPvrSectionHandler();
@@ -26,6 +27,7 @@ public:
   int   AddFilter(u_short Pid, u_char Tid, u_char Mask);
   void  RemoveFilter(int Handle);
   void  ProcessTSPacket(const u_char *Data);
+  int   Sections(void) const { return __atomic_load_n(&sections, __ATOMIC_RELAXED); }
 };
 
 #endif
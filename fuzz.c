@@ -0,0 +1,314 @@
+/*
+pvrinput-fuzz: feeds arbitrary data through the PS parser and the VBI
+packetizer of the remuxer and checks what comes out. Built with 'make fuzz',
+doesn't need vdr or a card. Every TS packet must be 188 bytes with sync byte
+and a continuous continuity counter per PID, every PES packet handed to the
+drift monitor must be complete. Violations abort(), so ASan, libFuzzer and
+AFL see them as crashes.
+
+  pvrinput-fuzz [file ...]                  run each file once (AFL: @@ or stdin)
+  pvrinput-fuzz -n 100000 [-r seed] [file]  mutate the files (or a built-in
+                                            stream) n times
+
+With clang the same file is a libFuzzer target:
+
+  make fuzz CXX=clang++ FUZZFLAGS="-g -O1 -fsanitize=fuzzer,address -DPVRINPUT_LIBFUZZER"
+
+The first byte of an input selects radio/teletext and how the rest is split
+into reads, so the state machine is also tested across read boundaries.
+*/
+#include "standalone.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int PvrStandaloneLogLevel = pvrUNUSED;
+
+void log(int level, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "pvrinput-fuzz: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
+// no members: so the pes_buffer of cPvrRemux is at the end of cFuzzRemux and ASan sees overruns
+static int cc[0x2000];
+
+class cFuzzRemux : public cPvrRemux {
+protected:
+  virtual void PutTs(const uint8_t *Data, int Count);
+  virtual void Pes(uint8_t *Data, uint32_t Length);
+public:
+  cFuzzRemux(void) { Start(); }
+  void Start(void) { for (int i = 0; i < 0x2000; i++) cc[i] = -1; }
+};
+
+static void Fail(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "pvrinput-fuzz: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  abort();
+}
+
+void cFuzzRemux::PutTs(const uint8_t *Data, int Count)
+{
+  if (Count != TS_SIZE)
+     Fail("TS packet of %d bytes", Count);
+  if (Data[0] != TS_SYNC_BYTE)
+     Fail("sync byte 0x%02x", Data[0]);
+  int pid = ((Data[1] & 0x1F) << 8) | Data[2];
+  int counter = Data[3] & 0x0F;
+  if ((cc[pid] >= 0) && (counter != ((cc[pid] + 1) & 0x0F)))
+     Fail("PID %d continuity counter %d after %d", pid, counter, cc[pid]);
+  cc[pid] = counter;
+  if ((Data[3] & 0x20) && (Data[4] > TS_SIZE - 5))
+     Fail("PID %d adaptation field of %d bytes", pid, Data[4]);
+}
+
+void cFuzzRemux::Pes(uint8_t *Data, uint32_t Length)
+{
+  if ((Length < 6) || (Data[0] != 0x00) || (Data[1] != 0x00) || (Data[2] != 0x01))
+     Fail("PES packet of %u bytes without start code", Length);
+  if (Length != 6 + (uint32_t)((Data[4] << 8) | Data[5]))
+     Fail("PES packet of %u bytes, header says %d", Length, 6 + ((Data[4] << 8) | Data[5]));
+}
+
+static cFuzzRemux *remux = NULL;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size)
+{
+  if (Size < 1)
+     return 0;
+  if (!remux)
+     remux = new cFuzzRemux;
+  uint8_t flags = Data[0];
+  remux->Start();
+  remux->Reset(1, 1, flags & 0x01, flags & 0x02);
+  // read sizes from 1 byte up to everything at once
+  uint32_t seed = flags >> 2;
+  size_t pos = 1;
+  while (pos < Size) {
+    size_t n = Size - pos;
+    if (seed) {
+       seed = seed * 1103515245 + 12345;
+       size_t max = ((seed >> 16) % 4096) + 1;
+       if (n > max)
+          n = max;
+       }
+    remux->ParseProgramStream(Data + pos, n);
+    pos += n;
+    }
+  return 0;
+}
+
+#ifndef PVRINPUT_LIBFUZZER
+
+// --- built-in seed: pack header, video, audio, itv0 and ITV0 VBI ----------
+
+static size_t PesHeader(uint8_t *p, uint8_t StreamId, int PayloadLength)
+{
+  int pes_length = 3 + 5 + PayloadLength;
+  const uint8_t h[] = { 0x00, 0x00, 0x01, StreamId, (uint8_t)(pes_length >> 8), (uint8_t)pes_length,
+                        0x81, 0x80, 0x05, 0x21, 0x00, 0x01, 0x00, 0x01 };
+  memcpy(p, h, sizeof(h));
+  return sizeof(h);
+}
+
+static size_t Seed(uint8_t *p)
+{
+  const uint8_t pack[] = { 0x00, 0x00, 0x01, 0xBA, 0x44, 0x00, 0x04, 0x00, 0x04, 0x01, 0x89, 0xC3, 0xF8, 0xF8 };
+  size_t len = 0;
+  for (int frame = 0; frame < 4; frame++) {
+      memcpy(p + len, pack, sizeof(pack));
+      len += sizeof(pack);
+      int video = 500 + frame * 97;
+      len += PesHeader(p + len, 0xE0, video);
+      for (int i = 0; i < video; i++)
+          p[len++] = 0x10 + (i & 0x3F);
+      len += PesHeader(p + len, 0xC0, 184);
+      memset(p + len, 0x55, 184);
+      len += 184;
+      v4l2_mpeg_vbi_fmt_ivtv vbi;
+      memset(&vbi, 0, sizeof(vbi));
+      int vbiLength;
+      if (frame & 1) {
+         memcpy(vbi.magic, "itv0", 4);
+         vbi.itv0.linemask[0] = 0x0000F00E;
+         vbi.itv0.linemask[1] = 0x00000001;
+         for (int n = 0; n < 8; n++)
+             vbi.itv0.line[n].id = (n == 7) ? V4L2_MPEG_VBI_IVTV_WSS_625 : V4L2_MPEG_VBI_IVTV_TELETEXT_B;
+         vbiLength = 4 + 8 + 8 * sizeof(v4l2_mpeg_vbi_itv0_line);
+         }
+      else {
+         memcpy(vbi.magic, "ITV0", 4);
+         for (int line = 2; line < 12; line++)
+             vbi.ITV0.line[line].id = V4L2_MPEG_VBI_IVTV_TELETEXT_B;
+         vbi.ITV0.line[10].id = V4L2_MPEG_VBI_IVTV_VPS;
+         vbiLength = 4 + sizeof(vbi.ITV0);
+         }
+      // ivtv pads the PES header of VBI packets to 36 bytes
+      int pes_length = 3 + 36 + vbiLength;
+      const uint8_t h[] = { 0x00, 0x00, 0x01, 0xBD, (uint8_t)(pes_length >> 8), (uint8_t)pes_length, 0x81, 0x80, 36 };
+      memcpy(p + len, h, sizeof(h));
+      len += sizeof(h);
+      memset(p + len, 0xFF, 36);
+      len += 36;
+      memcpy(p + len, &vbi, vbiLength);
+      len += vbiLength;
+      }
+  return len;
+}
+
+// --- a simple mutator for boxes without libFuzzer or AFL ------------------
+
+static uint32_t seed = 1;
+
+static uint32_t Random(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static size_t Mutate(uint8_t *Data, size_t Length, size_t MaxLength)
+{
+  static const uint8_t interesting[][4] = {
+    { 0x00, 0x00, 0x01, 0xBA }, { 0x00, 0x00, 0x01, 0xBB }, { 0x00, 0x00, 0x01, 0xBD },
+    { 0x00, 0x00, 0x01, 0xE0 }, { 0xFF, 0xFF, 0xFF, 0xFF }, { 'i', 't', 'v', '0' }, { 'I', 'T', 'V', '0' } };
+  int n = 1 + Random() % 8;
+  for (int i = 0; (i < n) && (Length > 0); i++) {
+      size_t pos = Random() % Length;
+      switch (Random() % 6) {
+        case 0: Data[pos] ^= 1 << (Random() % 8); break;
+        case 1: Data[pos] = Random(); break;
+        case 2: Data[pos] = (Random() & 1) ? 0x00 : 0xFF; break;
+        case 3: if (pos + 4 <= Length)
+                   memcpy(Data + pos, interesting[Random() % (sizeof(interesting) / 4)], 4);
+                break;
+        case 4: { // cut out a block
+                size_t len = Random() % 512;
+                if (len > Length - pos)
+                   len = Length - pos;
+                memmove(Data + pos, Data + pos + len, Length - pos - len);
+                Length -= len;
+                }
+                break;
+        case 5: { // duplicate a block
+                size_t len = Random() % 512;
+                if (len > Length - pos)
+                   len = Length - pos;
+                if (len > MaxLength - Length)
+                   len = MaxLength - Length;
+                memmove(Data + pos + len, Data + pos, Length - pos);
+                Length += len;
+                }
+                break;
+        }
+      }
+  return Length;
+}
+
+static bool ReadFile(FILE *f, uint8_t *&Data, size_t &Length)
+{
+  size_t size = 65536;
+  Length = 0;
+  Data = (uint8_t *)malloc(size);
+  size_t n;
+  while ((n = fread(Data + Length, 1, size - Length, f)) > 0) {
+    Length += n;
+    if (Length == size)
+       Data = (uint8_t *)realloc(Data, size *= 2);
+    }
+  return !ferror(f);
+}
+
+static bool ReadFile(const char *FileName, uint8_t *&Data, size_t &Length)
+{
+  FILE *f = fopen(FileName, "rb");
+  if (!f) {
+     fprintf(stderr, "pvrinput-fuzz: %s: %s\n", FileName, strerror(errno));
+     return false;
+     }
+  bool ok = ReadFile(f, Data, Length);
+  fclose(f);
+  return ok;
+}
+
+static void Usage(void)
+{
+  fprintf(stderr,
+    "usage: pvrinput-fuzz [options] [file ...]\n"
+    "  -n iterations  mutate the inputs (or a built-in stream) n times\n"
+    "  -r seed        seed of the mutator (default 1)\n"
+    "  -v             log the messages of the remuxer\n"
+    "without -n each file (or stdin) is run once.\n");
+}
+
+int main(int argc, char *argv[])
+{
+  long iterations = 0;
+  int c;
+  while ((c = getopt(argc, argv, "n:r:vh")) != -1) {
+    switch (c) {
+      case 'n': iterations = atol(optarg); break;
+      case 'r': seed = strtoul(optarg, NULL, 0); break;
+      case 'v': PvrStandaloneLogLevel = pvrDEBUG3; break;
+      default:  Usage(); return 2;
+      }
+    }
+  int inputs = (optind < argc) ? argc - optind : 1;
+  uint8_t **data = new uint8_t *[inputs];
+  size_t *length = new size_t[inputs];
+  if (optind < argc) {
+     for (int i = 0; i < inputs; i++) {
+         if (!ReadFile(argv[optind + i], data[i], length[i]))
+            return 1;
+         }
+     }
+  else if (iterations > 0) {
+     data[0] = (uint8_t *)malloc(65536);
+     data[0][0] = 0x06; // teletext, reads of random size
+     length[0] = 1 + Seed(data[0] + 1);
+     }
+  else if (!ReadFile(stdin, data[0], length[0]))
+     return 1;
+
+  if (iterations <= 0) {
+     for (int i = 0; i < inputs; i++)
+         LLVMFuzzerTestOneInput(data[i], length[i]);
+     }
+  else {
+     // the same seed and inputs give the same sequence, so a crash can be repeated
+     size_t maxLength = 0;
+     for (int i = 0; i < inputs; i++)
+         if (length[i] > maxLength)
+            maxLength = length[i];
+     maxLength += 4096;
+     uint8_t *buffer = (uint8_t *)malloc(maxLength);
+     for (long n = 0; n < iterations; n++) {
+         int i = Random() % inputs;
+         memcpy(buffer, data[i], length[i]);
+         size_t len = Mutate(buffer, length[i], maxLength);
+         LLVMFuzzerTestOneInput(buffer, len);
+         if ((n + 1) % 100000 == 0)
+            fprintf(stderr, "pvrinput-fuzz: %ld inputs\n", n + 1);
+         }
+     free(buffer);
+     printf("pvrinput-fuzz: %ld inputs without errors\n", iterations);
+     }
+  for (int i = 0; i < inputs; i++)
+      free(data[i]);
+  delete [] data;
+  delete [] length;
+  delete remux;
+  return 0;
+}
+
+#endif
@@ -2,6 +2,9 @@
 #define _PVRINPUT_GLOBAL_H_
 
 static const int kMaxPvrDevices = 8;
+static const int kMaxFileDevices = 8;
+static const int kMaxDevices = kMaxPvrDevices + kMaxFileDevices;
+static const int kFirstFileDevice = 100; // number of the first file device, instead of /dev/videoX
 
 #define INVALID_VALUE -1000
 
@@ -0,0 +1,89 @@
+#include "common.h"
+
+cPvrGopGate::cPvrGopGate(void)
+: closed(false),
+  h264(false),
+  pmtPid(-1),
+  videoPid(-1),
+  since(0),
+  dropped(0),
+  scan(0xFFFFFFFF),
+  held(0)
+{
+}
+
+void cPvrGopGate::Close(uint64_t NowMs)
+{
+  closed = true;
+  since = NowMs;
+  dropped = 0;
+  held = 0;
+}
+
+/*
+looks for the start codes in the payload of a video packet, including those
+which began in the packet before
+*/
+bool cPvrGopGate::Search(const uint8_t *Packet)
+{
+  if (!(Packet[3] & 0x10)) // no payload
+     return false;
+  int offset = 4;
+  if (Packet[3] & 0x20)
+     offset += 1 + Packet[4];
+  if ((Packet[1] & 0x40) && (offset + 9 <= TS_SIZE) &&
+      (Packet[offset] == 0x00) && (Packet[offset + 1] == 0x00) && (Packet[offset + 2] == 0x01))
+     offset += 9 + Packet[offset + 8]; // PES header
+  for (int i = offset; i < TS_SIZE; i++) {
+      scan = (scan << 8) | Packet[i];
+      if ((scan & 0xFFFFFF00) != 0x00000100)
+         continue;
+      uint8_t code = scan & 0xFF;
+      if (h264 ? (!(code & 0x80) && ((code & 0x1F) == 7)) : (code == 0xB3)) // SPS, sequence_header_code
+         return true;
+      }
+  return false;
+}
+
+/*
+returns true if Packet is to be delivered now. Returns false for dropped
+packets and for the packets of the current video PES, which are kept in
+hold. If the gate opens on such a packet, the caller delivers Held() first.
+*/
+bool cPvrGopGate::Pass(const uint8_t *Packet, uint64_t NowMs)
+{
+  if (!closed)
+     return true;
+  int pid = ((Packet[1] & 0x1F) << 8) | Packet[2];
+  if ((pid == 0) || (pid == pmtPid))
+     return true;
+  if (NowMs - since >= kTimeoutMs) {
+     closed = false;
+     dropped += held;
+     held = 0;
+     return true;
+     }
+  if (pid != videoPid) {
+     dropped += TS_SIZE;
+     return false;
+     }
+  if (Packet[1] & 0x40) { // a new PES, the one before had no entry point
+     dropped += held;
+     held = 0;
+     scan = 0xFFFFFFFF;
+     }
+  else if (!held) { // rest of a PES which started before Close() or was too long
+     dropped += TS_SIZE;
+     return false;
+     }
+  if (held + TS_SIZE > (int)sizeof(hold)) {
+     dropped += held + TS_SIZE;
+     held = 0;
+     return false;
+     }
+  memcpy(hold + held, Packet, TS_SIZE);
+  held += TS_SIZE;
+  if (Search(Packet))
+     closed = false;
+  return false;
+}
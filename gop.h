@@ -0,0 +1,43 @@
+#ifndef _PVRINPUT_GOP_H_
+#define _PVRINPUT_GOP_H_
+
+/*
+After a zap the first TS packets belong to the middle of a GOP, which the
+decoder of vdr can't show. With pvrinput.GopAlign the gate drops the
+elementary streams until the video reaches a point where decoding can start:
+an MPEG-2 sequence header (the encoders put it in front of each I-frame) or
+an H.264 SPS (in front of each IDR picture). The PES packets of ivtv and
+cx18 don't start with a picture, so the packets of the current video PES
+are held back and searched, start codes may be split between two packets.
+The PES with the entry point is delivered from its start, the ones before
+are dropped. PAT and PMT always pass. Streams without such a point are let
+through after kTimeoutMs.
+*/
+class cPvrGopGate {
+private:
+  enum { kHoldPackets = 512 };   // longer PES are dropped without searching further
+  bool     closed;
+  bool     h264;
+  int      pmtPid;
+  int      videoPid;    // -1 = not known yet, the gate waits for the PMT
+  uint64_t since;       // ms of Close()
+  int      dropped;     // bytes since Close()
+  uint32_t scan;        // last bytes of the video payload
+  int      held;        // bytes in hold, 0 = not inside a PES
+  uint8_t  hold[kHoldPackets * TS_SIZE]; // the current video PES up to here
+  bool Search(const uint8_t *Packet);
+public:
+  enum { kTimeoutMs = 2000 };
+  cPvrGopGate(void);
+  void SetPmtPid(int Pid) { pmtPid = Pid; }
+  void SetVideoPid(int Pid, bool H264) { videoPid = Pid; h264 = H264; }
+  void Close(uint64_t NowMs);
+  bool Closed(void) const { return closed; }
+  bool Pass(const uint8_t *Packet, uint64_t NowMs);
+  const uint8_t *Held(void) const { return hold; }
+  int HeldBytes(void) const { return held; }
+  int Waited(uint64_t NowMs) const { return (int)(NowMs - since); }
+  int Dropped(void) const { return dropped; }
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "common.h"
+
+#define PRESSURE_SECONDS   2  // step down after this many seconds under pressure
+#define RELAXED_SECONDS   15  // step up after this many seconds without
+
+cPvrBitrateGovernor::cPvrBitrateGovernor(cPvrDevice *Device)
+: device(Device),
+  level(0),
+  pressure(0),
+  relaxed(0),
+  dropped(0)
+{
+}
+
+/*
+the cx2341x drivers (ivtv, cx18, pvrusb2) return EBUSY for the bitrate
+controls while the encoder runs, see HISTORY
+*/
+bool cPvrBitrateGovernor::Supported(const cPvrDevice *Device)
+{
+  return Device->driver == hdpvr;
+}
+
+/*
+called by the reader after each read, evaluates once a second
+*/
+void cPvrBitrateGovernor::Check(int Fill, int Size)
+{
+  cPvrSetup &setup = device->setup;
+  if (!setup.BitrateGovernor || (Size <= 0) || (timer.Elapsed() < 1000))
+     return;
+  timer.Set();
+  if ((device->CurrentInputType == eRadio) || (setup.BitrateGovernorStep <= 0) || !Supported(device))
+     return;
+  int applied = device->BitrateLevel();
+  if (applied < 0) // the encoder refused a step, stay where it is
+     return;
+  if (applied != level) { // the tune thread is still at it
+     dropped = 0;
+     return;
+     }
+  int percent = Fill * 100 / Size;
+  if (dropped || (percent >= setup.BitrateGovernorHigh)) {
+     relaxed = 0;
+     if (++pressure >= PRESSURE_SECONDS) {
+        pressure = 0;
+        if (100 - (level + 1) * setup.BitrateGovernorStep >= setup.BitrateGovernorMin)
+           device->RequestBitrateLevel(++level);
+        }
+     }
+  else if (percent <= setup.BitrateGovernorLow) {
+     pressure = 0;
+     if (level && (++relaxed >= RELAXED_SECONDS)) {
+        relaxed = 0;
+        device->RequestBitrateLevel(--level);
+        }
+     }
+  else
+     pressure = relaxed = 0;
+  dropped = 0;
+}
+
+/*
+back to the configured bitrate, e.g. when the reader stops
+*/
+void cPvrBitrateGovernor::Restore(void)
+{
+  if (level)
+     device->RequestBitrateLevel(0);
+  level = pressure = relaxed = dropped = 0;
+}
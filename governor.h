@@ -0,0 +1,30 @@
+#ifndef _PVRINPUT_GOVERNOR_H_
+#define _PVRINPUT_GOVERNOR_H_
+
+/*
+Lowers the video bitrate of the encoder step by step while vdr doesn't take
+the packets fast enough (ring buffer filled above BitrateGovernorHigh percent
+or packets dropped) and raises it again after the buffer stayed below
+BitrateGovernorLow percent for a while. The setup values are not changed.
+The reader only decides on the steps, the tune thread sends them to the
+encoder (cPvrDevice::ApplyBitrateLevel). Only the HD PVR takes a new bitrate
+while it encodes, the cx2341x cards (ivtv, cx18, pvrusb2) refuse it.
+*/
+class cPvrBitrateGovernor {
+private:
+  cPvrDevice *device;
+  int level;      // number of steps below the configured bitrate, as requested
+  int pressure;   // seconds in a row with a full buffer or dropped packets
+  int relaxed;    // seconds in a row with an empty buffer
+  int dropped;    // bytes dropped since the last check
+  cTimeMs timer;
+public:
+  cPvrBitrateGovernor(cPvrDevice *Device);
+  static bool Supported(const cPvrDevice *Device);
+  void Dropped(int Bytes) { dropped += Bytes; }
+  void Check(int Fill, int Size);
+  void Restore(void);
+  int Level(void) const { return level; }
+};
+
+#endif
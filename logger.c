@@ -0,0 +1,169 @@
+#include "common.h"
+
+cPvrLogger PvrLogger;
+
+cPvrLogger::cPvrLogger(void)
+: cThread("pvrinput logger"),
+  enqueuePos(0),
+  dequeuePos(0),
+  dropped(0),
+  active(false),
+  lastLevel(-1),
+  repeated(0),
+  repeatStart(0)
+{
+  for (int i = 0; i < kSlots; i++)
+      slots[i].seq = i;
+  lastText[0] = 0;
+}
+
+void cPvrLogger::StartLogging(void)
+{
+  if (!Running()) {
+     Start();
+     __atomic_store_n(&active, true, __ATOMIC_RELEASE);
+     }
+}
+
+void cPvrLogger::StopLogging(void)
+{
+  __atomic_store_n(&active, false, __ATOMIC_RELEASE);
+  if (Running()) {
+     Cancel(-1);
+     wakeup.Signal();
+     Cancel(3);
+     }
+  // messages queued while the thread was stopping. A producer may have taken
+  // a slot without having filled it yet, give it a moment before giving up.
+  for (int waited = 0; dequeuePos != __atomic_load_n(&enqueuePos, __ATOMIC_ACQUIRE); ) {
+      if (Dequeue())
+         continue;
+      if (waited++ >= kDrainWait) {
+         int lost = __atomic_load_n(&enqueuePos, __ATOMIC_ACQUIRE) - dequeuePos;
+         __atomic_add_fetch(&dropped, lost, __ATOMIC_RELAXED);
+         break;
+         }
+      cCondWait::SleepMs(1);
+      }
+  FlushRepeated();
+  ReportDropped();
+}
+
+/*
+bounded multi producer queue (D. Vyukov): each slot carries a sequence number,
+a producer owns a slot after moving enqueuePos with a CAS. Only the logger
+thread dequeues.
+*/
+bool cPvrLogger::Queue(int level, const char *fmt, va_list ap)
+{
+  if (!__atomic_load_n(&active, __ATOMIC_ACQUIRE))
+     return false;
+  tLogSlot *slot;
+  size_t pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+  for (;;) {
+    slot = &slots[pos % kSlots];
+    size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+    if (dif == 0) {
+       if (__atomic_compare_exchange_n(&enqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+          break;
+       }
+    else if (dif < 0) { // full, don't wait for the logger thread
+       __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+       return true;
+       }
+    else
+       pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+    }
+  slot->level = level;
+  slot->time = time(NULL);
+  vsnprintf(slot->text, sizeof(slot->text), fmt, ap);
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool cPvrLogger::Dequeue(void)
+{
+  tLogSlot *slot = &slots[dequeuePos % kSlots];
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != dequeuePos + 1)
+     return false;
+  Consume(slot->level, slot->time, slot->text);
+  __atomic_store_n(&slot->seq, dequeuePos + kSlots, __ATOMIC_RELEASE);
+  dequeuePos++;
+  return true;
+}
+
+/*
+the first message of a group of identical ones is always printed, the others
+only counted
+*/
+void cPvrLogger::Consume(int level, time_t When, const char *text)
+{
+  if ((level == lastLevel) && !strcmp(text, lastText)) {
+     if (!repeated++)
+        repeatStart = When;
+     return;
+     }
+  FlushRepeated();
+  Output(level, When, text);
+  strn0cpy(lastText, text, sizeof(lastText));
+  lastLevel = level;
+}
+
+void cPvrLogger::FlushRepeated(void)
+{
+  if (repeated) {
+     char tmpstr[kTextSize + 64];
+     snprintf(tmpstr, sizeof(tmpstr), "%s (repeated %d times)", lastText, repeated);
+     Output(lastLevel, time(NULL), tmpstr);
+     repeated = 0;
+     }
+}
+
+void cPvrLogger::ReportDropped(void)
+{
+  int lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+  if (lost) {
+     char tmpstr[64];
+     snprintf(tmpstr, sizeof(tmpstr), "log buffer full, %d messages dropped", lost);
+     Output(pvrERROR, time(NULL), tmpstr);
+     }
+}
+
+void cPvrLogger::Action(void)
+{
+  while (Running()) {
+    bool any = false;
+    while (Dequeue())
+      any = true;
+    ReportDropped();
+    // don't hold back a message storm forever
+    if (repeated && (time(NULL) - repeatStart >= kRepeatInterval))
+       FlushRepeated();
+    if (!any)
+       wakeup.Wait(50);
+    }
+}
+
+void cPvrLogger::Output(int level, time_t When, const char *text)
+{
+  char timestr[16];
+  struct tm local;
+  localtime_r(&When, &local);
+  strftime(timestr, sizeof(timestr), "%H:%M:%S", &local);
+  printf("pvrinput: %s %s\n", timestr, text);
+  switch (level) {
+    case pvrERROR:
+           esyslog("%s", text);
+           break;
+    case pvrINFO:
+           isyslog("%s", text);
+           break;
+    case pvrDEBUG1:
+    case pvrDEBUG2:
+    case pvrDEBUG3:
+    default:
+           dsyslog("%s", text);
+           break;
+    }
+}
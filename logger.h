@@ -0,0 +1,49 @@
+#ifndef _PVRINPUT_LOGGER_H_
+#define _PVRINPUT_LOGGER_H_
+
+/*
+log() only formats the message into a slot of a lock-free ring, the logger
+thread does the printf and syslog. Identical messages following each other
+are written once, followed by a line with their count.
+If the ring is full, messages are dropped and counted. As long as the thread
+isn't running (Initialize, after Stop) log() writes synchronously. Stopping
+drains the ring, messages whose producer didn't finish within kDrainWait
+are counted as dropped.
+*/
+class cPvrLogger : public cThread {
+private:
+  enum { kSlots = 256, kTextSize = 512, kRepeatInterval = 5, kDrainWait = 100 }; // kDrainWait in ms
+  struct tLogSlot {
+    size_t seq;
+    int level;
+    time_t time;
+    char text[kTextSize];
+  };
+  tLogSlot slots[kSlots];
+  size_t enqueuePos;
+  size_t dequeuePos;
+  int dropped;
+  bool active;
+  cCondWait wakeup;
+  // only used by the logger thread
+  int lastLevel;
+  int repeated;
+  time_t repeatStart;
+  char lastText[kTextSize]; // as printed
+  bool Dequeue(void);
+  void Consume(int level, time_t When, const char *text);
+  void FlushRepeated(void);
+  void ReportDropped(void);
+protected:
+  virtual void Action(void);
+public:
+  cPvrLogger(void);
+  void StartLogging(void);
+  void StopLogging(void);
+  bool Queue(int level, const char *fmt, va_list ap);
+  static void Output(int level, time_t When, const char *text);
+};
+
+extern cPvrLogger PvrLogger;
+
+#endif
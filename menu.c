@@ -227,11 +227,11 @@ void cPvrMenuSetup::Store()
   SETUPSTORE("FilterChromaMedianTop", PvrSetup.FilterChromaMedianTop);
 
   cPvrDevice::ReInitAll();
-  PvrSetup.repeat_ReInitAll_after_next_encoderstop = true;
 }
 
 cPvrMenuMain::cPvrMenuMain(void)
 : cOsdObject(),
+  osd(NULL),
   border(2),
   margin(4),
   mode(ePicPropBrightness)
@@ -239,13 +239,33 @@ cPvrMenuMain::cPvrMenuMain(void)
   font = cFont::GetFont(fontOsd);
   width = Setup.OSDWidth;
   height = 2 * font->Height() + 3 * border + 4 * margin;
+  // the picture settings belong to the device showing the live picture
+  pvr = NULL;
+  cDevice *device = cDevice::ActualDevice();
+  for (int i = 0; i < cPvrDevice::Count(); i++) {
+      if (cPvrDevice::Get(i) == device)
+         pvr = cPvrDevice::Get(i);
+      }
+  setup = pvr ? pvr->DeviceSetup() : &PvrSetup;
+  stats = NULL;
 }
 
 cPvrMenuMain::~cPvrMenuMain()
 {
+  delete stats;
   delete osd;
 }
 
+valSet cPvrSetup::*cPvrMenuMain::Property(void)
+{
+  switch (mode) {
+    case ePicPropContrast:   return &cPvrSetup::Contrast;
+    case ePicPropSaturation: return &cPvrSetup::Saturation;
+    case ePicPropHue:        return &cPvrSetup::Hue;
+    default:                 return &cPvrSetup::Brightness;
+    }
+}
+
 void cPvrMenuMain::Draw(void)
 {
   static const char * pictureProperties[4] = {
@@ -258,34 +278,11 @@ void cPvrMenuMain::Draw(void)
   int titleWidth   = font->Width(tr(pictureProperties[mode])) + 2 * border + 2 * margin;
   int titleHeight  = font->Height() + border + 2 * margin;
   int titleStart   = 50;
-  int localvalue   = PvrSetup.Brightness.value;
-  int localminimum = PvrSetup.Brightness.queryctrl.minimum;
-  int localmaximum = PvrSetup.Brightness.queryctrl.maximum;
-  
-  switch (mode) {
-    case ePicPropBrightness:
-      localvalue = PvrSetup.Brightness.value;
-      localminimum = PvrSetup.Brightness.queryctrl.minimum;
-      localmaximum = PvrSetup.Brightness.queryctrl.maximum;
-      break;
-    case ePicPropContrast:
-      localvalue = PvrSetup.Contrast.value;
-      localminimum = PvrSetup.Contrast.queryctrl.minimum;
-      localmaximum = PvrSetup.Contrast.queryctrl.maximum;
-      break;
-    case ePicPropSaturation:
-      localvalue = PvrSetup.Saturation.value;
-      localminimum = PvrSetup.Saturation.queryctrl.minimum;
-      localmaximum = PvrSetup.Saturation.queryctrl.maximum;
-      break;
-    case ePicPropHue:
-      localvalue = PvrSetup.Hue.value;
-      localminimum = PvrSetup.Hue.queryctrl.minimum;
-      localmaximum = PvrSetup.Hue.queryctrl.maximum;
-      break;
-    }
+  valSet &property = setup->*Property();
+  int localvalue   = property.value;
+  int localminimum = property.queryctrl.minimum;
+  int localmaximum = property.queryctrl.maximum;
   int barWidth = (localvalue - localminimum) * (width - font->Width("100%") - 2 * border - 3 * margin) / (localmaximum - localminimum);
-
   osd->DrawRectangle(0, 0, width - 1, height - 1, clrTransparent);
   osd->DrawRectangle(0, titleHeight, width - 1, height - 1, clrBlack);
   osd->DrawRectangle(titleStart, 0, titleStart + titleWidth - 1, titleHeight - 1, clrBlack);
@@ -321,9 +318,23 @@ void cPvrMenuMain::Show(void) {
 
 eOSState cPvrMenuMain::ProcessKey(eKeys Key)
 {
+  if (stats) {
+     eOSState state = stats->ProcessKey(Key);
+     if (state == osEnd) { // back to the picture settings
+        DELETENULL(stats);
+        Show();
+        state = osContinue;
+        }
+     return state;
+     }
   eOSState state = cOsdObject::ProcessKey(Key);
   if (state == osUnknown) {
     switch (Key & ~k_Repeat) {
+      case kBlue:
+        DELETENULL(osd);
+        stats = new cPvrMenuStats();
+        stats->Show();
+        break;
       case kUp:
         mode--;
         if (mode < ePicPropBrightness)
@@ -337,103 +348,137 @@ eOSState cPvrMenuMain::ProcessKey(eKeys Key)
         Draw();
         break;
       case kLeft:
-        switch (mode) {
-          case ePicPropBrightness:
-            if (PvrSetup.Brightness.value > PvrSetup.Brightness.queryctrl.minimum) {
-              PvrSetup.Brightness.value--;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Brightness, PvrSetup.Brightness.value);
-                  }
-              }
-            break;
-          case ePicPropContrast:
-            if (PvrSetup.Contrast.value > PvrSetup.Contrast.queryctrl.minimum) {
-              PvrSetup.Contrast.value--;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Contrast, PvrSetup.Contrast.value);
-                  }
-              }
-            break;
-          case ePicPropSaturation:
-            if (PvrSetup.Saturation.value > PvrSetup.Saturation.queryctrl.minimum) {
-              PvrSetup.Saturation.value--;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Saturation, PvrSetup.Saturation.value);
-                  }
-              }
-            break;
-          case ePicPropHue:
-            if (PvrSetup.Hue.value > PvrSetup.Hue.queryctrl.minimum) {
-              PvrSetup.Hue.value--;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Hue, PvrSetup.Hue.value);
-                  }
-              }
-            break;
-        }
-        Draw();
-        break;
       case kRight:
-        switch (mode)
         {
-          case ePicPropBrightness:
-            if (PvrSetup.Brightness.value < PvrSetup.Brightness.queryctrl.maximum) {
-              PvrSetup.Brightness.value++;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Brightness, PvrSetup.Brightness.value);
-                  }
-              }
-            break;
-          case ePicPropContrast:
-            if (PvrSetup.Contrast.value < PvrSetup.Contrast.queryctrl.maximum) {
-              PvrSetup.Contrast.value++;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                      pvr->SetControlValue(&PvrSetup.Contrast, PvrSetup.Contrast.value);
-                  }
-              }
-            break;
-          case ePicPropSaturation:
-            if (PvrSetup.Saturation.value < PvrSetup.Saturation.queryctrl.maximum) {
-              PvrSetup.Saturation.value++;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                      pvr->SetControlValue(&PvrSetup.Saturation, PvrSetup.Saturation.value);
-                  }
-              }
-            break;
-          case ePicPropHue:
-            if (PvrSetup.Hue.value < PvrSetup.Hue.queryctrl.maximum) {
-              PvrSetup.Hue.value++;
-              for (int i = 0; i < cPvrDevice::Count(); i++) {
-                  cPvrDevice *pvr = cPvrDevice::Get(i);
-                  if (pvr)
-                     pvr->SetControlValue(&PvrSetup.Hue, PvrSetup.Hue.value);
-                  }
-              }
-            break;
-        }
+        valSet cPvrSetup::*member = Property();
+        valSet &property = setup->*member;
+        int value = property.value + (((Key & ~k_Repeat) == kLeft) ? -1 : 1);
+        if ((value >= property.queryctrl.minimum) && (value <= property.queryctrl.maximum)) {
+          property.value = value;
+          if (pvr)
+             pvr->SetControlValue(&property, value);
+          else { // not on a pvrinput device: change the common value on all of them
+             for (int i = 0; i < cPvrDevice::Count(); i++) {
+                 cPvrDevice *dev = cPvrDevice::Get(i);
+                 if (dev)
+                    dev->SetControlValue(&(dev->DeviceSetup()->*member), value);
+                 }
+             }
+          }
         Draw();
         break;
+        }
       case kOk:
-        PluginPvrInput->SetupStore("Brightness", PvrSetup.Brightness.value);
-        PluginPvrInput->SetupStore("Contrast",   PvrSetup.Contrast.value);
-        PluginPvrInput->SetupStore("Saturation", PvrSetup.Saturation.value);
-        PluginPvrInput->SetupStore("Hue",        PvrSetup.Hue.value);
+        if (pvr) {
+           StoreCardSetting("Brightness", setup->Brightness.value);
+           StoreCardSetting("Contrast",   setup->Contrast.value);
+           StoreCardSetting("Saturation", setup->Saturation.value);
+           StoreCardSetting("Hue",        setup->Hue.value);
+           }
+        else {
+           PluginPvrInput->SetupStore("Brightness", PvrSetup.Brightness.value);
+           PluginPvrInput->SetupStore("Contrast",   PvrSetup.Contrast.value);
+           PluginPvrInput->SetupStore("Saturation", PvrSetup.Saturation.value);
+           PluginPvrInput->SetupStore("Hue",        PvrSetup.Hue.value);
+           }
+        return osEnd;
+      case kBack:
         return osEnd;
+      default:
+        return state;
+    }
+    state = osContinue;
+  }
+  return state;
+}
+
+void cPvrMenuMain::StoreCardSetting(const char *Name, int Value)
+{
+  cString name = cPvrSetup::CardSettingName(pvr->GetBusID(), Name);
+  cString value = cString::sprintf("%d", Value);
+  PluginPvrInput->SetupStore(*name, *value);
+  cPvrSetup::ParseCardSetting(*name, *value); // SetupStore doesn't call SetupParse
+}
+
+cPvrMenuStats::cPvrMenuStats(void)
+: cOsdObject(),
+  osd(NULL),
+  border(2),
+  margin(4)
+{
+  font = cFont::GetFont(fontOsd);
+  lineHeight = font->Height();
+  width = Setup.OSDWidth;
+  height = (1 + 3 * max(cPvrDevice::Count(), 1)) * lineHeight + 2 * border + 2 * margin;
+  height = min(height, Setup.OSDHeight);
+}
+
+cPvrMenuStats::~cPvrMenuStats()
+{
+  delete osd;
+}
+
+void cPvrMenuStats::Draw(void)
+{
+  if (!osd)
+     return;
+  int x = border + margin;
+  int y = border + margin;
+  int w = width - 2 * x;
+  osd->DrawRectangle(0, 0, width - 1, height - 1, clrWhite);
+  osd->DrawRectangle(border, border, width - border - 1, height - border - 1, clrBlack);
+  osd->DrawText(x, y, tr("Setup.pvrinput$Statistics"), clrWhite, clrBlack, font, w);
+  y += lineHeight;
+  for (int i = 0; (i < cPvrDevice::Count()) && (y + 3 * lineHeight <= height - border); i++) {
+      cPvrDevice *dev = cPvrDevice::Get(i);
+      if (!dev)
+         continue;
+      tPvrStats s;
+      dev->GetStats(s);
+      cString signal = (s.signal >= 0) ? cString::sprintf("%d%%", s.signal) : cString("-");
+      cString zap = (s.lastZapMs >= 0) ? cString::sprintf("%d ms", s.lastZapMs) : cString("-");
+      cString line1 = cString::sprintf("/dev/video%d %s: %d kbit/s (peak %d), buffer %d%%%s, signal %s",
+                                       dev->Number(), dev->CardName(), s.kbps, s.peakKbps, s.bufferFill,
+                                       s.prefill ? *cString::sprintf(" (prefill %d%% left)", s.prefill) : "", *signal);
+      cString line2 = cString::sprintf("    %s, memory %d KB, overflows %d, resyncs %d, timeouts %d, last zap %s",
+                                       s.active ? "active" : "idle", s.bufferMemory / 1024, s.overflows, s.resyncs, s.timeouts, *zap);
+      cString line3 = cString::sprintf("    SCR %+d ppm, A/V %d ms (drift %+d ms, corrected %d ms), PTS jitter %d us",
+                                       s.drift.scrPpm, s.drift.avOffsetMs, s.drift.avDriftMs, s.drift.correctionMs, s.drift.ptsJitterUs);
+      tColor color = (s.overflows || s.resyncs) ? clrYellow : clrWhite;
+      osd->DrawText(x, y, line1, s.active ? clrWhite : clrGray50, clrBlack, font, w);
+      y += lineHeight;
+      osd->DrawText(x, y, line2, s.active ? color : clrGray50, clrBlack, font, w);
+      y += lineHeight;
+      osd->DrawText(x, y, line3, s.active ? clrWhite : clrGray50, clrBlack, font, w);
+      y += lineHeight;
+      }
+  osd->Flush();
+}
+
+void cPvrMenuStats::Show(void)
+{
+  osd = cOsdProvider::NewOsd(Setup.OSDLeft, Setup.OSDTop);
+  tArea area = { 0, 0, width - 1, height - 1, 4 };
+  if (osd->CanHandleAreas(&area, 1) == oeOk)
+     osd->SetAreas(&area, 1);
+  Draw();
+  refresh.Set();
+}
+
+eOSState cPvrMenuStats::ProcessKey(eKeys Key)
+{
+  eOSState state = cOsdObject::ProcessKey(Key);
+  if (state == osUnknown) {
+    switch (Key & ~k_Repeat) {
+      case kNone:
+        if (refresh.Elapsed() >= 1000) {
+           Draw();
+           refresh.Set();
+           }
+        break;
+      case kOk:
       case kBack:
+      case kBlue:
         return osEnd;
       default:
         return state;
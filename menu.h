@@ -47,6 +47,29 @@ public:
   virtual eOSState ProcessKey(eKeys Key);
 };
 
+/*
+statistics of all cards, refreshed once a second from the counters of the
+read threads. Opened with the blue key from cPvrMenuMain, or directly from
+the main menu if the live channel isn't an analogue one.
+*/
+class cPvrMenuStats : public cOsdObject {
+private:
+  cOsd *osd;
+  const cFont *font;
+  int border;
+  int margin;
+  int width;
+  int height;
+  int lineHeight;
+  cTimeMs refresh;
+  void Draw(void);
+public:
+  cPvrMenuStats(void);
+  virtual ~cPvrMenuStats();
+  virtual void Show(void);
+  virtual eOSState ProcessKey(eKeys Key);
+};
+
 class cPvrMenuMain : public cOsdObject {
 private:
   cOsd *osd;
@@ -56,8 +79,13 @@ private:
   int width;
   int height;
   int mode;
+  cPvrDevice *pvr;
+  cPvrSetup *setup;
+  cPvrMenuStats *stats;
 
+  valSet cPvrSetup::*Property(void);
   void Draw(void);
+  void StoreCardSetting(const char *Name, int Value);
 public:
   cPvrMenuMain(void);
   virtual ~cPvrMenuMain();
@@ -0,0 +1,140 @@
+#include "common.h"
+
+#define FAMILY(name, type, help) fprintf(f, "# HELP pvrinput_" name " " help "\n# TYPE pvrinput_" name " " type "\n")
+
+cPvrMetrics PvrMetrics;
+
+cPvrMetrics::cPvrMetrics(void)
+: cThread("pvrinput metrics", true)
+{
+}
+
+void cPvrMetrics::StartWriting(void)
+{
+  if (*PvrSetup.MetricsFile && !Running())
+     Start();
+}
+
+void cPvrMetrics::StopWriting(void)
+{
+  if (Running()) {
+     Cancel(-1);
+     wakeup.Signal();
+     Cancel(3);
+     }
+}
+
+void cPvrMetrics::Action(void)
+{
+  while (Running()) {
+    Write();
+    wakeup.Wait(max(PvrSetup.MetricsInterval, 1) * 1000);
+    }
+}
+
+struct tPvrMetricsDevice {
+  cPvrDevice *device;
+  cString labels;
+  tPvrTotals totals;
+  tPvrStats stats;
+};
+
+void cPvrMetrics::WriteFile(FILE *f)
+{
+  tPvrMetricsDevice devices[kMaxDevices];
+  int n = 0;
+  for (int i = 0; i < cPvrDevice::Count(); i++) {
+      cPvrDevice *dev = cPvrDevice::Get(i);
+      if (!dev)
+         continue;
+      devices[n].device = dev;
+      devices[n].labels = cString::sprintf("device=\"/dev/video%d\",card=\"%s\"", dev->Number(), dev->CardName());
+      dev->GetTotals(devices[n].totals);
+      dev->GetStats(devices[n].stats, false);
+      n++;
+      }
+
+  FAMILY("bytes_read_total", "counter", "Bytes read from the encoder.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_bytes_read_total{%s} %llu\n", *devices[i].labels, (unsigned long long)devices[i].totals.bytesRead);
+  FAMILY("packets_total", "counter", "TS packets put into the ring buffer for vdr.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_packets_total{%s} %llu\n", *devices[i].labels, (unsigned long long)(devices[i].totals.bytesPut / TS_SIZE));
+  FAMILY("overflow_bytes_total", "counter", "Bytes dropped because the ring buffer was full.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_overflow_bytes_total{%s} %llu\n", *devices[i].labels, (unsigned long long)devices[i].totals.overflowBytes);
+  FAMILY("sync_skipped_bytes_total", "counter", "Bytes skipped to find the next TS sync byte.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_sync_skipped_bytes_total{%s} %llu\n", *devices[i].labels, (unsigned long long)devices[i].totals.syncSkipBytes);
+  FAMILY("psi_sections_total", "counter", "PSI sections delivered to the section filters of vdr.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_psi_sections_total{%s} %d\n", *devices[i].labels, devices[i].device->Sections());
+  FAMILY("ioctl_retries_total", "counter", "Ioctls which had to be tried again.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_ioctl_retries_total{%s} %d\n", *devices[i].labels, devices[i].device->IoctlRetries());
+  FAMILY("reader_cpu_seconds_total", "counter", "CPU time of the read threads, with ReaderPipeline also of the remux threads.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_reader_cpu_seconds_total{%s} %.3f\n", *devices[i].labels, devices[i].totals.readerCpuNs / 1e9);
+  FAMILY("reader_syscalls_total", "counter", "Selects, reads and polls of the read thread, divide by bytes_read_total for the syscalls per byte.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_reader_syscalls_total{%s} %llu\n", *devices[i].labels, (unsigned long long)devices[i].totals.syscalls);
+  FAMILY("reader_stall_seconds_total", "counter", "Time the read thread waited for a free buffer (ReaderPipeline).");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_reader_stall_seconds_total{%s} %.3f\n", *devices[i].labels, devices[i].totals.stallMs / 1e3);
+  FAMILY("zap_latency_seconds", "histogram", "Time from a channel switch for live view to the first packet for vdr.");
+  for (int i = 0; i < n; i++) {
+      uint64_t cumulative = 0;
+      for (int b = 0; b < tPvrTotals::kZapBuckets; b++) {
+          cumulative += devices[i].totals.zapBuckets[b];
+          if (b < tPvrTotals::kZapBuckets - 1)
+             fprintf(f, "pvrinput_zap_latency_seconds_bucket{%s,le=\"%g\"} %llu\n", *devices[i].labels,
+                     cPvrStreamStats::kZapBucketMs[b] / 1000.0, (unsigned long long)cumulative);
+          else
+             fprintf(f, "pvrinput_zap_latency_seconds_bucket{%s,le=\"+Inf\"} %llu\n", *devices[i].labels, (unsigned long long)cumulative);
+          }
+      fprintf(f, "pvrinput_zap_latency_seconds_sum{%s} %.3f\n", *devices[i].labels, devices[i].totals.zapSumMs / 1000.0);
+      fprintf(f, "pvrinput_zap_latency_seconds_count{%s} %llu\n", *devices[i].labels, (unsigned long long)devices[i].totals.zapCount);
+      }
+  FAMILY("active", "gauge", "1 while the read thread of the device is running.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_active{%s} %d\n", *devices[i].labels, devices[i].stats.active ? 1 : 0);
+  FAMILY("bitrate_kbps", "gauge", "Bitrate of the last full second.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_bitrate_kbps{%s} %d\n", *devices[i].labels, devices[i].stats.kbps);
+  FAMILY("buffer_fill_ratio", "gauge", "Fill level of the ring buffer.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_buffer_fill_ratio{%s} %.2f\n", *devices[i].labels, devices[i].stats.bufferFill / 100.0);
+  FAMILY("buffer_memory_bytes", "gauge", "Ring buffer and read buffer the device holds.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_buffer_memory_bytes{%s} %d\n", *devices[i].labels, devices[i].stats.bufferMemory);
+  FAMILY("scr_drift_ppm", "gauge", "Rate of the SCR against the system clock, program streams only.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_scr_drift_ppm{%s} %d\n", *devices[i].labels, devices[i].stats.drift.scrPpm);
+  FAMILY("av_offset_seconds", "gauge", "Audio PTS - video PTS, averaged.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_av_offset_seconds{%s} %.3f\n", *devices[i].labels, devices[i].stats.drift.avOffsetMs / 1000.0);
+  FAMILY("av_drift_seconds", "gauge", "Change of the A/V offset since the start of the stream.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_av_drift_seconds{%s} %.3f\n", *devices[i].labels, devices[i].stats.drift.avDriftMs / 1000.0);
+  FAMILY("av_correction_seconds", "gauge", "Currently subtracted from the audio PTS (DriftCorrection).");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_av_correction_seconds{%s} %.3f\n", *devices[i].labels, devices[i].stats.drift.correctionMs / 1000.0);
+  FAMILY("pts_jitter_seconds", "gauge", "Averaged deviation of video PTS - SCR from its mean.");
+  for (int i = 0; i < n; i++)
+      fprintf(f, "pvrinput_pts_jitter_seconds{%s} %.6f\n", *devices[i].labels, devices[i].stats.drift.ptsJitterUs / 1e6);
+}
+
+void cPvrMetrics::Write(void)
+{
+  cString tmpName = cString::sprintf("%s.tmp", PvrSetup.MetricsFile);
+  FILE *f = fopen(tmpName, "w");
+  if (!f) {
+     log(pvrERROR, "cPvrMetrics: can't write %s: %d:%s", *tmpName, errno, strerror(errno));
+     return;
+     }
+  WriteFile(f);
+  if ((fclose(f) != 0) || (rename(tmpName, PvrSetup.MetricsFile) != 0)) {
+     log(pvrERROR, "cPvrMetrics: can't write %s: %d:%s", PvrSetup.MetricsFile, errno, strerror(errno));
+     unlink(tmpName);
+     }
+}
@@ -0,0 +1,26 @@
+#ifndef _PVRINPUT_METRICS_H_
+#define _PVRINPUT_METRICS_H_
+
+/*
+Writes the counters of all devices every MetricsInterval seconds to
+MetricsFile in the Prometheus text format, for the textfile collector of the
+node exporter. The file is written under a temporary name and renamed, so
+the collector never sees half of it. The file is written by a thread of its
+own with low priority, so a busy vdr main loop doesn't delay it.
+*/
+class cPvrMetrics : public cThread {
+private:
+  cCondWait wakeup;
+  static void WriteFile(FILE *f);
+  void Write(void);
+protected:
+  virtual void Action(void);
+public:
+  cPvrMetrics(void);
+  void StartWriting(void);
+  void StopWriting(void);
+};
+
+extern cPvrMetrics PvrMetrics;
+
+#endif
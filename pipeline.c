@@ -0,0 +1,36 @@
+#include "common.h"
+
+cPvrRemuxThread::cPvrRemuxThread(cPvrReadThread *Reader, int Number)
+: reader(Reader),
+  active(true)
+{
+  SetDescription("PvrRemuxThread of /dev/video%d", Number);
+  Start();
+}
+
+cPvrRemuxThread::~cPvrRemuxThread(void)
+{
+  __atomic_store_n(&active, false, __ATOMIC_RELEASE);
+  wakeup.Signal();
+  if (Running())
+     Cancel(3);
+}
+
+void cPvrRemuxThread::Action(void)
+{
+  tPvrChunk chunk;
+  cTimeMs cpuTimer;
+  while (Running() && __atomic_load_n(&active, __ATOMIC_ACQUIRE)) {
+    if (cpuTimer.Elapsed() >= 1000) {
+       reader->parent->stats.ReaderCpu(false, cPvrStreamStats::kRemuxThread);
+       cpuTimer.Set();
+       }
+    if (reader->filled.Pop(chunk)) {
+       reader->Process(chunk.data, chunk.length);
+       reader->empty.Push(chunk);
+       }
+    else if (!wakeup.Wait(100)) // no data: keep the quality estimate going
+       reader->UpdateErrors(cTimeMs::Now());
+    }
+  reader->parent->stats.ReaderCpu(true, cPvrStreamStats::kRemuxThread);
+}
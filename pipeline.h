@@ -0,0 +1,63 @@
+#ifndef _PVRINPUT_PIPELINE_H_
+#define _PVRINPUT_PIPELINE_H_
+
+class cPvrReadThread;
+
+struct tPvrChunk {
+  uint8_t *data;
+  int length;
+};
+
+/*
+wait-free queue between exactly one producer and one consumer thread
+*/
+class cPvrChunkQueue {
+public:
+  enum { kCapacity = 64 }; // power of two
+private:
+  tPvrChunk chunks[kCapacity];
+  unsigned int head; // only written by the producer
+  unsigned int tail; // only written by the consumer
+public:
+  cPvrChunkQueue(void) : head(0), tail(0) {}
+  bool Push(const tPvrChunk &Chunk)
+  {
+    unsigned int h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    if (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= kCapacity)
+       return false;
+    chunks[h % kCapacity] = Chunk;
+    __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+  bool Pop(tPvrChunk &Chunk)
+  {
+    unsigned int t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == t)
+       return false;
+    Chunk = chunks[t % kCapacity];
+    __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+  int Count(void) const { return (int)(__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)); }
+};
+
+/*
+With pvrinput.ReaderPipeline the read thread only does select() and read()
+into a fixed set of buffers and queues them, this thread remuxes them and
+gives the buffers back. A slow remux pass then no longer delays the next
+read(), bursts are taken up by the queue. If all buffers are queued, the
+read thread waits (a stall) and the data stays in the driver.
+*/
+class cPvrRemuxThread : public cThread {
+private:
+  cPvrReadThread *reader;
+  bool active;
+protected:
+  virtual void Action(void);
+public:
+  cCondWait wakeup;  // signalled by the read thread after queueing a chunk
+  cPvrRemuxThread(cPvrReadThread *Reader, int Number);
+  virtual ~cPvrRemuxThread(void);
+};
+
+#endif
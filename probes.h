@@ -0,0 +1,31 @@
+#ifndef _PVRINPUT_PROBES_H_
+#define _PVRINPUT_PROBES_H_
+
+/*
+USDT probes for perf and bpftrace, e.g.
+  bpftrace -e 'usdt:./libvdr-pvrinput.so:pvrinput:ioctl { @us[arg1] = hist(arg3); }'
+A probe which isn't attached is a nop in the code. They are only compiled in
+with 'make PVR_USDT=1', which needs <sys/sdt.h> (systemtap-sdt-dev), as
+the ioctl probe reads the clock twice per ioctl even without a tracer.
+
+  read            device, bytes          read() of the read thread returned
+  pes             stream_id, length      the PS parser completed a PES packet
+  pes_to_ts       stream_id, packets     PesToTs() sends a PES packet as TS
+  overflow        device, bytes          the ring buffer was full, bytes dropped
+  get_ts_packet   device, available      GetTSPacket() hands a packet to vdr
+  section         pid, tid, length       a section was written to a filter of vdr
+  ioctl           fd, cmd, result, us, retries
+  encoder_state   device, state          0 = stop, 1 = start
+*/
+#ifdef PVR_USDT
+#include <sys/sdt.h>
+#define PVR_PROBE2(name, a, b)             DTRACE_PROBE2(pvrinput, name, a, b)
+#define PVR_PROBE3(name, a, b, c)          DTRACE_PROBE3(pvrinput, name, a, b, c)
+#define PVR_PROBE5(name, a, b, c, d, e)    DTRACE_PROBE5(pvrinput, name, a, b, c, d, e)
+#else
+#define PVR_PROBE2(name, a, b)             do { } while (0)
+#define PVR_PROBE3(name, a, b, c)          do { } while (0)
+#define PVR_PROBE5(name, a, b, c, d, e)    do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _PVRINPUT_PROFILE_H_
+#define _PVRINPUT_PROFILE_H_
+
+enum ePvrStage { psSelect, psRead, psParse, psVideo, psAudio, psVbi, psPutData, psRing, psCount };
+
+/*
+Time spent by the read thread in its stages, with pvrinput.ProfileReader.
+Stages nest (PesToTs inside the parser, PutData inside PesToTs), each one
+only gets the time not spent in the stages it entered, so the parts add up.
+CLOCK_MONOTONIC is read from the vDSO, which costs some 20 ns per Enter() and
+Leave() and works on every architecture, unlike rdtsc.
+*/
+class cPvrStageProfile {
+private:
+  enum { kDepth = 8 };
+  uint64_t ns[psCount];
+  uint64_t bytes;
+  int stack[kDepth];
+  int depth;
+  uint64_t mark;
+  static uint64_t Now(void)
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+public:
+  cPvrStageProfile(void) { Reset(); }
+  void Reset(void);
+  void Enter(int Stage)
+  {
+    uint64_t now = Now();
+    if (depth > 0)
+       ns[stack[depth - 1]] += now - mark;
+    if (depth < kDepth)
+       stack[depth++] = Stage;
+    mark = now;
+  }
+  void Leave(void)
+  {
+    uint64_t now = Now();
+    if (depth > 0)
+       ns[stack[--depth]] += now - mark;
+    mark = now;
+  }
+  void Bytes(int Count) { bytes += Count; }
+  uint64_t TotalNs(void) const;
+  int Report(char *Buffer, int Size) const;
+  static int StreamStage(uint8_t StreamId) { return (StreamId == 0xBD) ? psVbi : ((StreamId & 0xF0) == 0xE0) ? psVideo : psAudio; }
+};
+
+#endif
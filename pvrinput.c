@@ -63,6 +63,8 @@ bool cPluginPvrInput::Start(void)
 /* Start() is called after the primary device and user interface has
    been set up, but before the main program loop is entered. Is called
    after Initialize(). */
+  PvrLogger.StartLogging();
+  PvrMetrics.StartWriting();
   return true;
 }
 
@@ -70,11 +72,20 @@ void cPluginPvrInput::Stop(void)
 {
 /* Any threads the plugin may have created shall be stopped
    in the Stop() function. See VDR/PLUGINS.html */
+  PvrMetrics.StopWriting();
   cPvrDevice::StopAll();
+  PvrLogger.StopLogging();
 };
 
 void cPluginPvrInput::Housekeeping(void)
 {
+  cPvrDevice::ReleaseIdleBuffers();
+  cPvrSourceParam::CheckChannels();
+}
+
+void cPluginPvrInput::MainThreadHook(void)
+{
+  cPvrDevice::PreTune();
 }
 
 const char *cPluginPvrInput::MainMenuEntry(void)
@@ -112,45 +123,9 @@ cMenuSetupPage *cPluginPvrInput::SetupMenu(void)
 
 bool cPluginPvrInput::SetupParse(const char *Name, const char *Value)
 {
-  if      (!strcasecmp(Name, "LogLevel"))                     PvrSetup.LogLevel                       = atoi(Value);
-  else if (!strcasecmp(Name, "UseOnlyCard"))                  PvrSetup.UseOnlyCard                    = atoi(Value);
-  else if (!strcasecmp(Name, "SliceVBI"))                     PvrSetup.SliceVBI                       = atoi(Value);
-  else if (!strcasecmp(Name, "TunerAudioMode"))               PvrSetup.TunerAudioMode                 = atoi(Value);
-  else if (!strcasecmp(Name, "Brightness"))                   PvrSetup.Brightness.value               = atoi(Value);
-  else if (!strcasecmp(Name, "Contrast"))                     PvrSetup.Contrast.value                 = atoi(Value);
-  else if (!strcasecmp(Name, "Saturation"))                   PvrSetup.Saturation.value               = atoi(Value);
-  else if (!strcasecmp(Name, "Hue"))                          PvrSetup.Hue.value                      = atoi(Value);
-  else if (!strcasecmp(Name, "AudioVolumeTVCommon"))          PvrSetup.AudioVolumeTVCommon.value      = atoi(Value);
-  else if (!strcasecmp(Name, "AudioVolumeTVException"))       PvrSetup.AudioVolumeTVException.value   = atoi(Value);
-  else if (!strcasecmp(Name, "AudioVolumeTVExceptionCard"))   PvrSetup.AudioVolumeTVExceptionCard     = atoi(Value);
-  else if (!strcasecmp(Name, "AudioVolumeFM"))                PvrSetup.AudioVolumeFM.value            = atoi(Value);
-  else if (!strcasecmp(Name, "AudioSampling"))                PvrSetup.AudioSampling.value            = atoi(Value);
-  else if (!strcasecmp(Name, "VideoBitrateTV"))               PvrSetup.VideoBitrateTV.value           = atoi(Value) * 1000;
-  else if (!strcasecmp(Name, "AudioBitrate"))                 PvrSetup.AudioBitrate.value             = atoi(Value);
-  else if (!strcasecmp(Name, "BitrateMode"))                  PvrSetup.BitrateMode.value              = atoi(Value);
-  else if (!strcasecmp(Name, "AspectRatio"))                  PvrSetup.AspectRatio.value              = atoi(Value);
-  else if (!strcasecmp(Name, "StreamType"))                   PvrSetup.StreamType.value               = atoi(Value);
-  else if (!strcasecmp(Name, "FilterSpatialMode"))            PvrSetup.FilterSpatialMode.value        = atoi(Value);
-  else if (!strcasecmp(Name, "FilterSpatial"))                PvrSetup.FilterSpatial.value            = atoi(Value);
-  else if (!strcasecmp(Name, "FilterLumaSpatialType"))        PvrSetup.FilterLumaSpatialType.value    = atoi(Value);
-  else if (!strcasecmp(Name, "FilterChromaSpatialType"))      PvrSetup.FilterChromaSpatialType.value  = atoi(Value);
-  else if (!strcasecmp(Name, "FilterTemporalMode"))           PvrSetup.FilterTemporalMode.value       = atoi(Value);
-  else if (!strcasecmp(Name, "FilterTemporal"))               PvrSetup.FilterTemporal.value           = atoi(Value);
-  else if (!strcasecmp(Name, "FilterMedianType"))             PvrSetup.FilterMedianType.value         = atoi(Value);
-  else if (!strcasecmp(Name, "FilterLumaMedianBottom"))       PvrSetup.FilterLumaMedianBottom.value   = atoi(Value);
-  else if (!strcasecmp(Name, "FilterLumaMedianTop"))          PvrSetup.FilterLumaMedianTop.value      = atoi(Value);
-  else if (!strcasecmp(Name, "FilterChromaMedianBottom"))     PvrSetup.FilterChromaMedianBottom.value = atoi(Value);
-  else if (!strcasecmp(Name, "FilterChromaMedianTop"))        PvrSetup.FilterChromaMedianTop.value    = atoi(Value);
-  else if (!strcasecmp(Name, "HideMainMenuEntry"))            PvrSetup.HideMainMenuEntry              = atoi(Value);
-  else if (!strcasecmp(Name, "ReadBufferSizeKB"))             PvrSetup.ReadBufferSizeKB               = atoi(Value);
-  else if (!strcasecmp(Name, "TsBufferSizeMB"))               PvrSetup.TsBufferSizeMB                 = atoi(Value);
-  else if (!strcasecmp(Name, "TsBufferPrefillRatio"))         PvrSetup.TsBufferPrefillRatio           = atoi(Value);
-  else if (!strcasecmp(Name, "UseExternChannelSwitchScript")) PvrSetup.UseExternChannelSwitchScript   = atoi(Value);
-  else if (!strcasecmp(Name, "ExternChannelSwitchSleep"))     PvrSetup.ExternChannelSwitchSleep       = atoi(Value);
-  else if (!strcasecmp(Name, "HDPVR_AudioEncoding"))          PvrSetup.HDPVR_AudioEncoding.value      = atoi(Value) + 3;
-  else if (!strcasecmp(Name, "HDPVR_AudioInput"))             PvrSetup.HDPVR_AudioInput               = atoi(Value);
-  else return false;
-  return true;
+  if (cPvrSetup::ParseCardSetting(Name, Value))
+     return true;
+  return PvrSetup.Parse(Name, Value);
 }
 
 VDRPLUGINCREATOR(cPluginPvrInput); // Don't touch this!
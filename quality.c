@@ -0,0 +1,68 @@
+#include "common.h"
+
+#define WINDOW_MS        1000
+#define RESYNC_PENALTY   20   // per PS resync in a window
+#define UNDERRUN_PENALTY 10   // per read timeout in a window
+
+cPvrQualityMonitor::cPvrQualityMonitor(void)
+{
+  Reset();
+}
+
+void cPvrQualityMonitor::Reset(void)
+{
+  memset(&last, 0, sizeof(last));
+  windowStart = 0;
+  __atomic_store_n(&quality, -1, __ATOMIC_RELEASE);
+}
+
+/*
+called by the read thread with the totals since the remuxer was reset
+*/
+void cPvrQualityMonitor::Update(const tPvrStreamErrors &Totals, uint64_t NowMs)
+{
+  if (!windowStart) {
+     last = Totals;
+     windowStart = NowMs;
+     return;
+     }
+  if (NowMs - windowStart < WINDOW_MS)
+     return;
+  int ttxBytes  = Totals.ttxBytes  - last.ttxBytes;
+  int ttxErrors = Totals.ttxErrors - last.ttxErrors;
+  int wssLines  = Totals.wssLines  - last.wssLines;
+  int wssErrors = Totals.wssErrors - last.wssErrors;
+  int vpsLines  = Totals.vpsLines  - last.vpsLines;
+  int vpsErrors = Totals.vpsErrors - last.vpsErrors;
+  int resyncs   = Totals.resyncs   - last.resyncs;
+  int underruns = Totals.underruns - last.underruns;
+  last = Totals;
+  windowStart = NowMs;
+
+  // VBI: teletext counts three times, a quarter of broken addresses is unusable
+  int sum = 0;
+  int weight = 0;
+  if (ttxBytes > 0) {
+     sum += 3 * max(0, 100 - (400 * ttxErrors) / ttxBytes);
+     weight += 3;
+     }
+  if (wssLines > 0) {
+     sum += 100 - (100 * wssErrors) / wssLines;
+     weight++;
+     }
+  if (vpsLines > 0) {
+     sum += 100 - (100 * vpsErrors) / vpsLines;
+     weight++;
+     }
+  int q = weight ? sum / weight : 100; // radio or no sliced VBI: only the stream counts
+  q -= RESYNC_PENALTY * resyncs + UNDERRUN_PENALTY * underruns;
+  q = constrain(q, 0, 100);
+
+  int old = __atomic_load_n(&quality, __ATOMIC_ACQUIRE);
+  if (old >= 0)
+     q = (3 * old + q + 2) / 4;
+  __atomic_store_n(&quality, q, __ATOMIC_RELEASE);
+  if (q != old)
+     dlog(pvrDEBUG3, "cPvrQualityMonitor: quality %d (teletext %d/%d, wss %d/%d, vps %d/%d, resyncs %d, underruns %d)",
+          q, ttxErrors, ttxBytes, wssErrors, wssLines, vpsErrors, vpsLines, resyncs, underruns);
+}
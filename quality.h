@@ -0,0 +1,24 @@
+#ifndef _PVRINPUT_QUALITY_H_
+#define _PVRINPUT_QUALITY_H_
+
+/*
+Estimates the reception quality for SignalQuality() from what the read thread
+sees anyway: Hamming 8/4 errors in the teletext packet addresses, WSS and VPS
+lines which can't be decoded, resyncs of the PS parser and reads where the
+encoder had no data. The read thread hands over its running totals, once a
+second the new errors are turned into a value from 0 to 100 which is then
+smoothed.
+*/
+class cPvrQualityMonitor {
+private:
+  tPvrStreamErrors last;   // totals at the start of the current window
+  uint64_t windowStart;    // ms
+  int quality;             // smoothed, -1 = unknown
+public:
+  cPvrQualityMonitor(void);
+  void Reset(void);
+  void Update(const tPvrStreamErrors &Totals, uint64_t NowMs);
+  int Quality(void) const { return __atomic_load_n(&quality, __ATOMIC_ACQUIRE); }
+};
+
+#endif
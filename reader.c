@@ -1,192 +1,27 @@
 #include "common.h"
-#include <libsi/si.h>
-
-#define _fourcc(p) (uint32_t) v4l2_fourcc(*(p), *(p+1), *(p+2), *(p+3))
-
-#define TS_HEADER(_PID, _PES_HDR, _COUNTER, _ADAPTATION_CTRL) ts_buffer[0] = TS_SYNC_BYTE; \
-           ts_buffer[1] = (_PES_HDR ? 0x40:0) | (_PID >> 8); \
-           ts_buffer[2] = _PID & 0xFF; \
-           ts_buffer[3] = _ADAPTATION_CTRL << 4 | (_COUNTER & 0xf)
-
-#define TS_PAYLOAD        0x1
-#define TS_ADAPTATION_FIELD 0x2
-
-#define SENDPATPMT_PACKETINTERVAL 500
-
-static const short kVideoPid    = 301;
-static const short kAudioPid    = 300;
-static const short kTeletextPid = 305;
-static const short kPCRPid      = 101;
-static const uint32_t itv0 = v4l2_fourcc('i','t','v','0');
-static const uint32_t ITV0 = v4l2_fourcc('I','T','V','0');
-
-
-const unsigned char kPAT[TS_SIZE] = {
-  0x47, 0x40, 0x00, 0x10, 0x00, 0x00, 0xb0, 0x0d,
-  0x00, 0x00, 0xc1, 0x00, 0x00, 0x00, 0x01, 0xe0,
-  0x84, 0xcc, 0x32, 0xcc, 0x32, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff
-};
-
-const unsigned char kPMTwithTeletext[TS_SIZE] = {
-  0x47, 0x40, 0x84, 0x10, 0x00, 0x02, 0xb0, 0x24,
-  0x00, 0x01, 0xc1, 0x00, 0x00, 0xe0, 0x65, 0xf0,
-  0x00, 0x02, 0xe1, 0x2d, 0xf0, 0x00, 0x04, 0xe1,
-  0x2c, 0xf0, 0x06, 0x0a, 0x04, 0x00, 0x00, 0x00,
-  0x01, 0x06, 0xe1, 0x31, 0xf0, 0x02, 0x56, 0x00,
-  0xcc, 0x32, 0xcc, 0x32, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff
-};
-
-const unsigned char kPMTwithoutTeletext[TS_SIZE] = {
-  0x47, 0x40, 0x84, 0x10, 0x00, 0x02, 0xb0, 0x1d,
-  0x00, 0x01, 0xc1, 0x00, 0x00, 0xe0, 0x65, 0xf0,
-  0x00, 0x02, 0xe1, 0x2d, 0xf0, 0x00, 0x04, 0xe1,
-  0x2c, 0xf0, 0x06, 0x0a, 0x04, 0x00, 0x00, 0x00,
-  0x01, 0xcc, 0x32, 0xcc, 0x32, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff
-};
-
-const unsigned char kPMTRadio[TS_SIZE] = {
-  0x47, 0x40, 0x84, 0x10, 0x00, 0x02, 0xb0, 0x18,
-  0x00, 0x01, 0xc1, 0x00, 0x00, 0xe0, 0x65, 0xf0,
-  0x00, 0x04, 0xe1, 0x2c, 0xf0, 0x06, 0x0a, 0x04,
-  0x00, 0x00, 0x00, 0x01, 0xcc, 0x32, 0xcc, 0x32,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff
-};
-
-const unsigned char kInvTab[256] = {
-  0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
-  0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
-  0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
-  0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
-  0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
-  0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
-  0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
-  0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
-  0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
-  0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
-  0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
-  0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
-  0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
-  0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
-  0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
-  0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
-  0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
-  0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
-  0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
-  0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
-  0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
-  0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
-  0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
-  0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
-  0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
-  0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
-  0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
-  0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
-  0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
-  0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
-  0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
-  0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
-};
-
-/* helper class for protected crc32-function in libsi */
-class cPvrCRC32 : public SI::CRC32 {
-public:
-  static inline u_int32_t crc32(const char *d, int len, u_int32_t CRCvalue) {
-    return SI::CRC32::crc32(d, len, CRCvalue);
-  }
-};
-
 
 cPvrReadThread::cPvrReadThread(cRingBufferLinear *TsBuffer, cPvrDevice *_parent)
 : tsBuffer(TsBuffer),
-  video_counter(0),
-  audio_counter(0),
-  text_counter(0),
-  pcr_counter(0),
-  packet_counter(0),
-  pes_stream_id(0),
-  pes_offset(0),
-  pes_length(0),
-  pes_tmp(0),
-  pes_scr_isvalid(false),
-  pes_scr(0),
-  pes_scr_ext(0)
+  governor(_parent),
+  ts_residual_len(0),
+  ts_pmt_pid(-1),
+  ts_null_packets(0),
+  ts_skipped_bytes(0),
+  ts_pid_map_active(false),
+  pace(false),
+  pace_valid(false),
+  pace_clock_valid(false),
+  pace_clock(0),
+  pace_clock_start(0),
+  pace_time_start(0),
+  wd_lastData(0),
+  wd_incident(0),
+  wd_tier(0),
+  underruns(0),
+  rs_latency(false),
+  rs_size(0),
+  rs_byteRate(0),
+  rs_bytes(0)
 {
   log(pvrDEBUG1, "cPvrReadThread");
   parent = _parent;
@@ -205,440 +40,542 @@ cPvrReadThread::~cPvrReadThread(void)
 
 int cPvrReadThread::PutData(const unsigned char *Data, int Count)
 {
+  if (__atomic_load_n(&parent->discardOutput, __ATOMIC_ACQUIRE)) // lingering after CloseDvr
+     return Count;
   if (!tsBuffer) {
-     log(pvrINFO,"cPvrReadThread::PutData():Unable to put data into RingBuffer");
+     dlog(pvrINFO,"cPvrReadThread::PutData():Unable to put data into RingBuffer");
      return 0;
      }
+  if (profile)
+     profile->Enter(psRing);
   int bytesFree = tsBuffer->Free();
+  if (profile)
+     profile->Leave();
   if (bytesFree < Count) {
-     log(pvrERROR,"cPvrReadThread::PutData():Unable to put data into RingBuffer, only %d bytes free, need %d", bytesFree, Count);
+     PVR_PROBE2(overflow, parent->number, Count);
+     governor.Dropped(Count);
+     parent->stats.Overflow(Count);
+     dlog(pvrERROR,"cPvrReadThread::PutData():Unable to put data into RingBuffer, only %d bytes free, need %d", bytesFree, Count);
      return 0;
      }
+  if (profile)
+     profile->Enter(psRing);
   int written = tsBuffer->Put(Data, Count);
+  if (profile)
+     profile->Leave();
+  parent->stats.Put(written);
   if (written != Count) {
-     log(pvrERROR,"cPvrReadThread::PutData():put incomplete data into RingBuffer, only %d bytes written, wanted %d", written, Count);
+     dlog(pvrERROR,"cPvrReadThread::PutData():put incomplete data into RingBuffer, only %d bytes written, wanted %d", written, Count);
+     PVR_PROBE2(overflow, parent->number, Count - written);
      tsBuffer->ReportOverflow(Count - written);
+     governor.Dropped(Count - written);
+     parent->stats.Overflow(Count - written);
      }
   return written;
 }
 
-
-void cPvrReadThread::PesToTs(uint8_t *Data, uint32_t Length)
+/*
+drops what comes before the entry point while the gate is closed
+*/
+void cPvrReadThread::PutTs(const uint8_t *Data, int Count)
 {
-  uint8_t stream_id;
-  bool write_PES_hdr = true;
-  uint32_t i;
-  const short *pid = &kVideoPid;
-  uint8_t *counter = &video_counter;
-  const short PayloadSize = TS_SIZE - 4;
-  uint32_t Payload_Count  = Length / PayloadSize;
-  uint32_t Payload_Rest   = Length % PayloadSize;
-  stream_id = Data[3];
-
-  if (packet_counter <= 0) { // time to send PAT and PMT
-     // increase continuity counter
-     pat_buffer[ 3] = (pat_buffer[ 3] & 0xF0) | (((pat_buffer[ 3] & 0x0F) + 1) & 0x0F);
-     pmt_buffer[ 3] = (pmt_buffer[ 3] & 0xF0) | (((pmt_buffer[ 3] & 0x0F) + 1) & 0x0F);
-     PutData(pat_buffer, TS_SIZE);
-     PutData(pmt_buffer, TS_SIZE);
-     packet_counter = SENDPATPMT_PACKETINTERVAL;
+  if (gate.Closed()) {
+     uint64_t now = cTimeMs::Now();
+     int run = 0; // start of the packets which pass
+     for (int i = 0; (i + TS_SIZE <= Count) && gate.Closed(); i += TS_SIZE) {
+         if (!gate.Pass(Data + i, now)) {
+            if (i > run)
+               Deliver(Data + run, i - run);
+            run = i + TS_SIZE;
+            if (!gate.Closed()) // opened in this packet, deliver its PES from the start
+               Deliver(gate.Held(), gate.HeldBytes());
+            }
+         }
+     if (!gate.Closed())
+        log(pvrDEBUG1, "cPvrReadThread: /dev/video%d starts %s after %d ms, dropped %d bytes", parent->number,
+            (gate.Waited(now) < cPvrGopGate::kTimeoutMs) ? "at an entry point" : "without entry point",
+            gate.Waited(now), gate.Dropped());
+     Data += run;
+     Count -= run;
+     if (Count <= 0)
+        return;
      }
+  Deliver(Data, Count);
+}
 
-  if (pes_scr_isvalid && (stream_id != 0xBD)) { // send PCR packet but not PCR of vbi data
-     TS_HEADER(kPCRPid, 0, pcr_counter, TS_ADAPTATION_FIELD);
-     ts_buffer[4] = 0xB7;
-     ts_buffer[5] = 0x10;
-     ts_buffer[6] = (pes_scr & 0x01FE000000ull) >> 25; // 33 bits SCR base
-     ts_buffer[7] = (pes_scr & 0x01FE0000) >> 17;
-     ts_buffer[8] = (pes_scr & 0x01FE00) >> 9;
-     ts_buffer[9] = (pes_scr & 0x01FE) >> 1;
-     ts_buffer[10] = (pes_scr & 0x01) << 7;
-     ts_buffer[10] |= 0x7E; // 6 bits between SCR and SCR extension
-     ts_buffer[10] |= (pes_scr_ext & 0x0100) >> 8; // 9 bits SCR extension
-     ts_buffer[11] = (pes_scr_ext & 0xFF);
-     memset(ts_buffer + 12, 0xFF, TS_SIZE - 12);
-     PutData(ts_buffer, TS_SIZE);
-     pcr_counter = (pcr_counter + 1) & 15;
-     pes_scr_isvalid = false;
+void cPvrReadThread::Deliver(const uint8_t *Data, int Count)
+{
+  if (profile) {
+     profile->Enter(psPutData);
+     PutData(Data, Count);
+     profile->Leave();
      }
+  else
+     PutData(Data, Count);
+}
 
-  switch (stream_id) {
-    case 0xC0 ... 0xDF: // ISO/IEC 13818-3 or ISO/IEC 11172-3 audio.
-         pid = &kAudioPid;
-         counter = &audio_counter;
-         // fall through to video stream
-
-    case 0xE0 ... 0xEF: // ITU-T Rec. H.262 | ISO/IEC 13818-2 or ISO/IEC 11172-2 video
-      if (parent->CurrentInputType == eRadio && stream_id >= 0xE0)      
-         return;   // skip video in case of "FM radio only" 
-
-      for (i = 0; i < Payload_Count; i++) {
-        TS_HEADER(*pid, write_PES_hdr, *counter, TS_PAYLOAD);
-        memcpy(ts_buffer + 4, Data + i * PayloadSize, PayloadSize);
-        PutData(ts_buffer, TS_SIZE);
-        packet_counter--;
-        *counter = (*counter + 1) & 15; //uint8_t
-        write_PES_hdr = false;
-        } // end: for (i = 0; i < Payload_Count; i++)
-      if (Payload_Rest > 0) {
-        TS_HEADER(*pid, write_PES_hdr, *counter, (TS_PAYLOAD | TS_ADAPTATION_FIELD));
-        ts_buffer[4] = PayloadSize - Payload_Rest - 1;
-        if (ts_buffer[4] > 0) {
-          ts_buffer[5] = 0x00;
-          memset(ts_buffer + 6, 0xFF, ts_buffer[4] - 1);
-          } //end: if (ts_buffer[4] > 0)
-        memcpy(ts_buffer + 5 + ts_buffer[4], Data + i * PayloadSize, Payload_Rest);
-        PutData(ts_buffer, TS_SIZE);
-        packet_counter--;
-        *counter = (*counter + 1) & 15;
-        write_PES_hdr = false;
-        } // end: if (Payload_Rest > 0)
-      break; // end: case 0xE0..0xEF:
-
-    case 0xBD: { // private_stream_1 (teletext, vps, wss and closed_caption)
-      uint16_t pes_bytes = 46;    // (9+36)byte PES header + 1byte data_identifier
-      uint16_t pes_mod;           // number of pes bytes in last TS packet
-      uint8_t  ts_bytes = 0;      // number of bytes of current TS packet
-      v4l2_mpeg_vbi_fmt_ivtv *vbi_fmt = (v4l2_mpeg_vbi_fmt_ivtv*)(Data + 9 + Data[8]);
-      v4l2_mpeg_vbi_itv0_line *vbi_line = 0;
-      uint32_t magic = _fourcc(vbi_fmt->magic);
-      uint32_t bitmask = 0;       // itv0 bitmask 
-      uint32_t *linemask = NULL;  // pointer to current itv0 32bit linemask.
-      uint8_t field_parity = 0;
-      uint8_t line_offset = 0;
-      uint8_t *dp = NULL;
-      uint8_t itv0_index = 0;     // index 0 corresponds to the first valid bit in linemask
-
-      if ((magic != itv0) && (magic != ITV0)) {
-          log(pvrERROR,"%s %d: skipping garbage teletext data.", __FUNCTION__, __LINE__);
-          return; 
-          }
-  
-      // count number of valid vbi lines to calculate length of pes packet
-      itv0_index = 0;
-      bitmask = 1;
-      linemask = &vbi_fmt->itv0.linemask[0];
-      for (int line = 0; line < 36; line++) {
-          if (magic == itv0) {
-             if (line > 34)  // only up to 35 lines in itv0.
-                break;
-             if (line == 32) {
-                linemask++;  // linemask[0] -> linemask[1]
-                bitmask = 1; // reinit bitmask
-                } 
-             if (*linemask & bitmask)  // this line found in dynamic itv0 array?
-                vbi_line = &vbi_fmt->itv0.line[itv0_index++];
-             else
-                vbi_line = NULL;
-             bitmask <<= 1;
-             }
-          else // magic == ITV0; static 36 line array of sliced vbi
-             vbi_line = &vbi_fmt->ITV0.line[line];
+void cPvrReadThread::ReportProfile(void)
+{
+  char report[256];
+  stageProfile.Report(report, sizeof(report));
+  log(pvrINFO, "cPvrReadThread: profile of /dev/video%d (%s): %s",
+      parent->number, parent->CardName(), report);
+  stageProfile.Reset();
+  profileTimer.Set();
+}
 
-          if (!vbi_line) continue; // itv0 and not in linemask
+void cPvrReadThread::Scr(uint64_t Scr)
+{
+  parent->drift.Scr(Scr);
+  if (pace)
+     PaceClock(Scr);
+}
 
-          switch (vbi_line->id) {
-                 case V4L2_MPEG_VBI_IVTV_TELETEXT_B:
-                 case V4L2_MPEG_VBI_IVTV_WSS_625:
-                 case V4L2_MPEG_VBI_IVTV_VPS:
-              // case V4L2_MPEG_VBI_IVTV_CAPTION_525:
-                    pes_bytes += 46; // aligned to (TS_SIZE - 4)/4
-                    break;
-                 default:;
-                 }
-          } // end for loop
+void cPvrReadThread::Pes(uint8_t *Data, uint32_t Length)
+{
+  parent->drift.Pes(Data, Length);
+}
 
-      if (pes_bytes < 47)
-         return; // no payload found.
+/*
+Map is a list of "from=to" pairs, separated by ',' or blanks, e.g.
+"0x1011=301,0x1100=300". Broken entries are logged and ignored.
+*/
+void cPvrReadThread::ParsePidMap(const char *Map)
+{
+  for (int i = 0; i < 0x2000; i++)
+      ts_pid_map[i] = i;
+  ts_pid_map_active = false;
+  const char *p = Map;
+  while (p && *p) {
+    while ((*p == ',') || (*p == ' '))
+      p++;
+    if (!*p)
+       break;
+    char *end;
+    long from = strtol(p, &end, 0);
+    long to = -1;
+    if ((end != p) && (*end == '=')) {
+       const char *q = end + 1;
+       to = strtol(q, &end, 0);
+       if (end == q)
+          to = -1;
+       }
+    if ((from < 1) || (from > 0x1FFE) || (to < 1) || (to > 0x1FFE)) {
+       log(pvrERROR, "cPvrReadThread: invalid entry in TsPidMap \"%s\"", Map);
+       while (*end && (*end != ',') && (*end != ' '))
+         end++;
+       }
+    else {
+       ts_pid_map[from] = to;
+       ts_pid_map_active = true;
+       }
+    p = end;
+    }
+}
 
-      // we need to fill up n-times 184bytes. if something is left over,
-      // fill up the last packet with stuffing bytes 0xFF
-      pes_mod = pes_bytes % 184;
-      if (pes_mod > 0)
-         pes_bytes += 184 - pes_mod;
+/*
+Streams of TS drivers: align on the sync byte also across reads, drop null
+packets, set the channel's SID in PAT and PMT and map PIDs if TsPidMap says so.
+*/
+void cPvrReadThread::PassThroughTs(uint8_t *Data, int Length)
+{
+  int pos = 0;
+  if (ts_residual_len > 0) { // complete the packet of the last read
+     pos = min(TS_SIZE - ts_residual_len, Length);
+     memcpy(ts_residual + ts_residual_len, Data, pos);
+     ts_residual_len += pos;
+     if (ts_residual_len < TS_SIZE)
+        return;
+     ts_residual_len = 0;
+     if ((pos >= Length) || (Data[pos] == TS_SYNC_BYTE)) {
+        if (NormalizeTsPacket(ts_residual))
+           PutTs(ts_residual, TS_SIZE);
+        }
+     else {
+        ts_skipped_bytes += TS_SIZE;
+        parent->stats.SyncSkipped(TS_SIZE);
+        }
+     }
+  int skipped = ts_skipped_bytes;
+  int out = 0; // packets we keep are moved to the start of Data
+  while (Length - pos >= TS_SIZE) {
+    // a sync byte counts if the next packet starts with one, too
+    if ((Data[pos] != TS_SYNC_BYTE) || ((Length - pos > TS_SIZE) && (Data[pos + TS_SIZE] != TS_SYNC_BYTE))) {
+       pos++;
+       ts_skipped_bytes++;
+       continue;
+       }
+    if (NormalizeTsPacket(Data + pos)) {
+       if (out != pos)
+          memmove(Data + out, Data + pos, TS_SIZE);
+       out += TS_SIZE;
+       }
+    pos += TS_SIZE;
+    }
+  while ((pos < Length) && (Data[pos] != TS_SYNC_BYTE)) {
+    pos++;
+    ts_skipped_bytes++;
+    }
+  if (pos < Length) {
+     ts_residual_len = Length - pos;
+     memcpy(ts_residual, Data + pos, ts_residual_len);
+     }
+  if (ts_skipped_bytes != skipped) {
+     errors.resyncs++;
+     parent->stats.SyncSkipped(ts_skipped_bytes - skipped);
+     dlog(pvrDEBUG1, "cPvrReadThread::PassThroughTs(): skipped %d bytes to sync on /dev/video%d",
+          ts_skipped_bytes - skipped, parent->number);
+     }
+  if (out > 0)
+     PutTs(Data, out);
+}
 
-      // begin of teletext PES packet. set payload start and increase counter after new TS hdr
-      TS_HEADER(kTeletextPid, 1, text_counter++, TS_PAYLOAD);
-      memcpy(&ts_buffer[4], Data, 9 + Data[8]);
-      ts_buffer[8] = (pes_bytes - 6) >> 8;    // PES hdr byte 5. pes_bytes - 6 byte ('00 00 01 BD xx xx')
-      ts_buffer[9] = (pes_bytes - 6) & 0xFF;  // PES hdr byte 6. pes_bytes - 6 byte ('00 00 01 BD xx xx')
-      ts_buffer[12] = 0x24;                   // PES hdr byte 9. PES hdr len, 0x24 -> 36 bytes PES hdr following
-      ts_buffer[49] = 0x10;                   // beginn payload after PES hdr, data identifier for EBU data 0x10
-      ts_bytes = 50;                          // 4byte hdr + 1/4 of 184 bytes payload per TS packet.
-      memset(&ts_buffer[ts_bytes], 0xFF, TS_SIZE - ts_bytes);
+/*
+returns false if the packet is to be dropped
+*/
+bool cPvrReadThread::NormalizeTsPacket(uint8_t *Packet)
+{
+  int pid = ((Packet[1] & 0x1F) << 8) | Packet[2];
+  if (pid == 0x1FFF) {
+     ts_null_packets++;
+     return false;
+     }
+  if (pace && (Packet[3] & 0x20) && (Packet[4] >= 7) && (Packet[5] & 0x10)) // PCR
+     PaceClock(((uint64_t)Packet[6] << 25) | (Packet[7] << 17) | (Packet[8] << 9) | (Packet[9] << 1) | (Packet[10] >> 7));
+  if (pid == 0)
+     RewritePat(Packet);
+  else if (pid == ts_pmt_pid)
+     RewritePmt(Packet);
+  int newpid = MapPid(pid);
+  if (newpid != pid) {
+     Packet[1] = (Packet[1] & 0xE0) | (newpid >> 8);
+     Packet[2] = newpid & 0xFF;
+     }
+  return true;
+}
 
-      // prepare for copy loop
-      itv0_index = 0;
-      bitmask = 1;
-      linemask = &vbi_fmt->itv0.linemask[0];
+/*
+start of the PSI section in Packet, if the whole section is inside it
+*/
+uint8_t *cPvrReadThread::TsSection(uint8_t *Packet, int TableId)
+{
+  if (!(Packet[1] & 0x40) || !(Packet[3] & 0x10)) // no payload start or no payload
+     return NULL;
+  int offset = 4;
+  if (Packet[3] & 0x20)
+     offset += 1 + Packet[4];
+  if (offset >= TS_SIZE)
+     return NULL;
+  offset += 1 + Packet[offset]; // pointer_field
+  if (offset + 3 > TS_SIZE)
+     return NULL;
+  uint8_t *s = Packet + offset;
+  int length = 3 + (((s[1] & 0x0F) << 8) | s[2]);
+  if ((s[0] != TableId) || (length < 12) || (offset + length > TS_SIZE))
+     return NULL;
+  return s;
+}
 
-      for (int line = 0; line < 36; line++) {
-          if (magic == itv0) {             
-             if (line > 34)  // up to 35 lines in itv0.
-                break;
-             if (line == 32) {
-                linemask++;  // linemask[0] -> linemask[1]
-                bitmask = 1; // reinit bitmask
-                } 
-             if (*linemask & bitmask)  // this line found in dynamic itv0 array?
-                vbi_line = &vbi_fmt->itv0.line[itv0_index++];
-             else
-                vbi_line = NULL;
-             bitmask <<= 1;
-             }
-          else // magic == ITV0; static 36 line array of sliced vbi
-             vbi_line = &vbi_fmt->ITV0.line[line];
+static void SetSectionCrc(uint8_t *Section)
+{
+  int length = 3 + (((Section[1] & 0x0F) << 8) | Section[2]) - 4;
+  uint32_t crc = cPvrRemux::Crc32(Section, length);
+  Section[length]     = crc >> 24;
+  Section[length + 1] = crc >> 16;
+  Section[length + 2] = crc >> 8;
+  Section[length + 3] = crc;
+}
 
-          if (!vbi_line) continue; // itv0 and not in linemask
+void cPvrReadThread::RewritePat(uint8_t *Packet)
+{
+  uint8_t *s = TsSection(Packet, 0x00);
+  if (!s)
+     return;
+  int sid = parent->CurrentChannel.Sid();
+  int tid = parent->CurrentChannel.Tid();
+  int end = 3 + (((s[1] & 0x0F) << 8) | s[2]) - 4;
+  s[3] = (tid >> 8) & 0xFF;
+  s[4] = tid & 0xFF;
+  for (int i = 8; i + 4 <= end; i += 4) {
+      int program = (s[i] << 8) | s[i + 1];
+      if (program == 0) // network PID
+         continue;
+      int pmtpid = ((s[i + 2] & 0x1F) << 8) | s[i + 3];
+      ts_pmt_pid = pmtpid;
+      gate.SetPmtPid(MapPid(pmtpid));
+      if (sid) {
+         s[i] = (sid >> 8) & 0xFF;
+         s[i + 1] = sid & 0xFF;
+         }
+      pmtpid = MapPid(pmtpid);
+      s[i + 2] = (s[i + 2] & 0xE0) | (pmtpid >> 8);
+      s[i + 3] = pmtpid & 0xFF;
+      break; // our encoders have only one program
+      }
+  SetSectionCrc(s);
+}
 
-          // itv0 is a variable length array that holds from 1 to 35 lines of sliced VBI data. The sliced VBI
-          // data lines present correspond to the bits set in the linemask array, starting from b0 of linemask[0]
-          // up through b31 of linemask[0], and from b0 of linemask[1] up through b 3 of linemask[1].
-          // line[0] corresponds to the first bit found set in the linemask array, line[1] corresponds to the
-          // second bit found set in the linemask array, etc. If no linemask array bits are set, then line[0]
-          // may contain one line of unspecified data that should be ignored by applications.
-          // NOTE: variable 'line' corresponds, if valid, to the same line_offset as in case of ITV0.
-          //
-          // v4l2 api: ITV0 line[0] through line [17] correspond to lines 6 through 23 of the first field.
-          //           line[18] through line[35] corresponds to lines 6 through 23 of the second field.
-          // en301775: field_parity: "The value '1' indicates the first field of a frame; the value '0' indicates 
-          //           the second field of a frame."
-          // en301775  Table 5: line_offset for EBU and Inverted Teletext
-          if (line < 18) {
-             field_parity = 1;
-             line_offset = line + 6;
-             }
-          else {
-             field_parity = 0;
-             line_offset = line - 12;
-             }
+void cPvrReadThread::RewritePmt(uint8_t *Packet)
+{
+  uint8_t *s = TsSection(Packet, 0x02);
+  if (!s)
+     return;
+  int sid = parent->CurrentChannel.Sid();
+  int end = 3 + (((s[1] & 0x0F) << 8) | s[2]) - 4;
+  if (sid) {
+     s[3] = (sid >> 8) & 0xFF;
+     s[4] = sid & 0xFF;
+     }
+  if (ts_pid_map_active) {
+     int pcrpid = MapPid(((s[8] & 0x1F) << 8) | s[9]);
+     s[8] = (s[8] & 0xE0) | (pcrpid >> 8);
+     s[9] = pcrpid & 0xFF;
+     int i = 12 + (((s[10] & 0x0F) << 8) | s[11]);
+     while (i + 5 <= end) {
+       int pid = MapPid(((s[i + 1] & 0x1F) << 8) | s[i + 2]);
+       s[i + 1] = (s[i + 1] & 0xE0) | (pid >> 8);
+       s[i + 2] = pid & 0xFF;
+       i += 5 + (((s[i + 3] & 0x0F) << 8) | s[i + 4]);
+       }
+     }
+  for (int i = 12 + (((s[10] & 0x0F) << 8) | s[11]); i + 5 <= end; i += 5 + (((s[i + 3] & 0x0F) << 8) | s[i + 4])) {
+      if ((s[i] == 0x01) || (s[i] == 0x02) || (s[i] == 0x1B)) { // MPEG-1/2 or H.264 video, already mapped
+         gate.SetVideoPid(((s[i + 1] & 0x1F) << 8) | s[i + 2], s[i] == 0x1B);
+         break;
+         }
+      }
+  SetSectionCrc(s);
+}
 
-          dp = &ts_buffer[ts_bytes];
+void cPvrReadThread::PrepareStream(void)
+{
+  if (parent->streamType != V4L2_MPEG_STREAM_TYPE_MPEG2_TS) {
+    Reset(parent->CurrentChannel.Sid(), parent->CurrentChannel.Tid(), parent->CurrentInputType == eRadio,
+          (parent->setup.SliceVBI != 0) && (cPvrDevice::VBIDeviceCount > 0));
+    gate.SetPmtPid(PmtPid());
+    gate.SetVideoPid(VideoPid(), false);
+    }
+  else {
+    ParsePidMap(parent->setup.TsPidMap);
+    gate.SetPmtPid(-1);     // from the PAT and PMT
+    gate.SetVideoPid(-1, false);
+    }
+}
 
-          switch (vbi_line->id) {
-            case V4L2_MPEG_VBI_IVTV_TELETEXT_B: {
-              *(dp++) = 0x02;  // data_unit_id
-              *(dp++) = 0x2C;  // data_unit_length (0x2C -> 44bytes still following)
-              *(dp++) = 0xC0 | (field_parity << 5) | (line_offset & 0x1f);
-              *(dp++) = 0xE4;  // framing_code 11100100 for EBU teletext, en300706
-              for (int i = 0; i < 42; i++) // 42 byte payload per line (inverse bit order); starting after Clock run-in
-                 *(dp++) = kInvTab[vbi_line->data[i]];
-              ts_bytes += 46;
-              break;
-              }
-            case V4L2_MPEG_VBI_IVTV_WSS_625: {
-              *(dp++) = 0xC4;  // data_unit_id
-              *(dp++) = 0x2C;  // data_unit_length: 1byte 0xF7 + 14bit data + 0b11 reserved + 40bytes filling.
-              *(dp++) = 0xF7;  // 0b11 + 1bit parity = 1 + 5bit fixed line 23
-              for (int i = 0; i < 2; i++)
-                  *(dp++) = kInvTab[vbi_line->data[i]]; // 14bit data
-              ts_bytes += 46;
-              break;
-              }
-            case V4L2_MPEG_VBI_IVTV_VPS: {
-              *(dp++) = 0xC3;  // data_unit_id
-              *(dp++) = 0x2C;  // data_unit_length: 1byte 0xF0 + 13byte data (after Start Code) + 29bytes filling.
-              *(dp++) = 0xF0;  // 0b11 + 1bit parity = 1 + 5bit fixed line 16
-              for (int i = 0; i < 13; i++)
-                  *(dp++) = kInvTab[vbi_line->data[i]]; // 13bytes in inverse bit order. en300231
-              ts_bytes += 46;
-              break;
-              }
-          //case V4L2_MPEG_VBI_IVTV_CAPTION_525: {
-          //  *(dp++) = 0xC5;  // data_unit_id
-          //  *(dp++) = 0x2C;  // data_unit_length: aligned to 46bytes
-          //                   // what structure here?
-          //  ts_bytes += 46; 
-          //  break;
-          //  }
-            default:;
-            }
+/*
+file devices don't know what they get: three sync bytes in a row make a
+transport stream, anything else is taken as program stream. Returns false
+if there isn't enough data to decide yet.
+*/
+bool cPvrReadThread::SniffStreamType(const uint8_t *Data, int Length)
+{
+  if (Length < 3 * TS_SIZE)
+     return false;
+  bool ts = false;
+  for (int i = 0; (i < TS_SIZE) && !ts; i++)
+      ts = (Data[i] == TS_SYNC_BYTE) && (Data[i + TS_SIZE] == TS_SYNC_BYTE) && (Data[i + 2 * TS_SIZE] == TS_SYNC_BYTE);
+  parent->streamType = ts ? V4L2_MPEG_STREAM_TYPE_MPEG2_TS : V4L2_MPEG_STREAM_TYPE_MPEG2_PS;
+  log(pvrINFO, "cPvrReadThread: file device %d delivers a %s stream", parent->number, ts ? "transport" : "program");
+  PrepareStream();
+  return true;
+}
 
-          if (ts_bytes >= TS_SIZE) {
-             PutData(ts_buffer, TS_SIZE);  // next (4 + 4*46) byte for TS packet reached. send packet
-             TS_HEADER(kTeletextPid, 0, text_counter++, TS_PAYLOAD);
-             ts_bytes = 4;                 // 4bytes TS hdr size
-             memset(&ts_buffer[ts_bytes], 0xFF, TS_SIZE - ts_bytes);
-             }
+/*
+file devices: don't deliver faster than the SCR/PCR says, as a card would.
+Jumps of more than 5s (a file starting again, a cut) start a new reference.
+*/
+void cPvrReadThread::Pace(void)
+{
+  if (!pace_clock_valid)
+     return;
+  uint64_t now = cTimeMs::Now();
+  int64_t ahead = 0;
+  if (pace_valid) {
+     uint64_t elapsed = (pace_clock - pace_clock_start) & 0x1FFFFFFFFULL; // 33 bit clock
+     ahead = (int64_t)(elapsed / 90) - (int64_t)(now - pace_time_start);
+     }
+  if (!pace_valid || (ahead > 5000) || (ahead < -5000)) {
+     pace_clock_start = pace_clock;
+     pace_time_start = now;
+     pace_valid = true;
+     return;
+     }
+  while ((ahead > 0) && Running() && parent->readThreadRunning) {
+    int ms = min((int)ahead, 100);
+    cCondWait::SleepMs(ms);
+    ahead -= ms;
+    }
+}
 
-          } // end copy for loop
+/*
+called after every read without data. If the encoder delivered nothing for
+WatchdogMs, the recovery goes one step further each time: restart the
+encoder, reopen the device, initialize it again and tune, give up.
+Returns false to give up.
+*/
+bool cPvrReadThread::Watchdog(void)
+{
+  int timeout = PvrSetup.WatchdogMs;
+  uint64_t now = cTimeMs::Now();
+  if ((timeout <= 0) || (now - wd_lastData < (uint64_t)timeout))
+     return true;
+  if (!wd_tier) {
+     wd_incident = wd_lastData;
+     parent->watchdogIncidents++;
+     }
+  wd_tier++;
+  switch (wd_tier) {
+    case 1:
+      log(pvrERROR, "cPvrReadThread: no data from /dev/video%d for %d ms, restarting the encoder",
+          parent->number, (int)(now - wd_incident));
+      break;
+    case 2:
+      log(pvrERROR, "cPvrReadThread: still no data from /dev/video%d, reopening it", parent->number);
+      break;
+    case 3:
+      log(pvrERROR, "cPvrReadThread: still no data from /dev/video%d, initializing it again", parent->number);
+      break;
+    default:
+      log(pvrERROR, "cPvrReadThread: /dev/video%d didn't recover within %d ms, giving up",
+          parent->number, (int)(now - wd_incident));
+      return false;
+    }
+  parent->RequestRecovery(wd_tier); // done by the tune thread
+  wd_lastData = cTimeMs::Now(); // each step gets the full time
+  return true;
+}
 
-      if (ts_bytes > 4) {
-         // need bit stuffing last TS packet.
-         // ts_buffer is set to 0xFF, so just set the data_unit_length for stuffing
-         for (;ts_bytes < TS_SIZE; ts_bytes += 46)
-             ts_buffer[1 + ts_bytes] = 0x2C;
+void cPvrReadThread::Recovered(void)
+{
+  static const char *steps[] = { "", "encoder restart", "reopen", "reinit" };
+  int ms = (int)(cTimeMs::Now() - wd_incident);
+  log(pvrINFO, "cPvrReadThread: /dev/video%d recovered after %d ms (%s)",
+      parent->number, ms, steps[wd_tier < 4 ? wd_tier : 3]);
+  parent->watchdogRecoveries++;
+  parent->watchdogLastMs = ms;
+  wd_tier = 0;
+}
 
-         PutData(ts_buffer, TS_SIZE);
-         }
-      break; // end: case 0xBD:
-      }
+/*
+pvrinput.CaptureMode: once a second the byte rate is measured and the mode
+chosen, latency mode while only a live viewer is attached, else throughput
+mode. A read() then asks for LatencyReadMs or ThroughputReadMs of stream.
+*/
+void cPvrReadThread::AdaptReadSize(int BufferSize)
+{
+  uint64_t elapsed = rs_timer.Elapsed();
+  if (elapsed < 1000)
+     return;
+  int rate = (int)(rs_bytes * 1000 / elapsed);
+  rs_byteRate = rs_byteRate ? (3 * rs_byteRate + rate) / 4 : rate;
+  rs_bytes = 0;
+  rs_timer.Set();
+  bool latency = parent->liveView && (parent->Priority() < 0);
+  if (latency != rs_latency) {
+     log(pvrDEBUG1, "cPvrReadThread: /dev/video%d switches to %s mode", parent->number, latency ? "latency" : "throughput");
+     rs_latency = latency;
+     }
+  int ms = rs_latency ? PvrSetup.LatencyReadMs : PvrSetup.ThroughputReadMs;
+  rs_size = constrain((int)((int64_t)rs_byteRate * ms / 1000), min(PvrSetup.ReadSizeMinKB * 1024, BufferSize), BufferSize);
+}
 
-    case 0xBE: // padding_stream
-      return;
+/*
+throughput mode after a short read: waits on the fd for at most TimeoutMs, so
+the driver collects more stream for the next read. No events are asked for,
+the wait only ends early if the device reports an error or hangs up, the
+next select and read then see it.
+*/
+void cPvrReadThread::WaitForStream(int TimeoutMs)
+{
+  if (TimeoutMs <= 0)
+     return;
+  struct pollfd pfd;
+  pfd.fd = parent->v4l2_fd;
+  pfd.events = 0;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, TimeoutMs) != 0)
+     dlog(pvrDEBUG2, "cPvrReadThread: /dev/video%d reports 0x%x while collecting stream", parent->number, pfd.revents);
+}
 
-    default:  // unexpected stream_id.
-      log(pvrDEBUG1,"%s: unhandled stream_id 0x%.2x", __FUNCTION__, stream_id); 
-    } // end: switch (stream_id)
+/*
+called by the thread which remuxes, the read thread or with ReaderPipeline
+the remux thread
+*/
+void cPvrReadThread::UpdateErrors(uint64_t Now)
+{
+  tPvrStreamErrors e = Errors();
+  e.underruns = __atomic_load_n(&underruns, __ATOMIC_RELAXED);
+  parent->quality.Update(e, Now);
+  parent->stats.Errors(e);
 }
 
-void cPvrReadThread::ParseProgramStream(uint8_t *Data, uint32_t Length)
+/*
+everything done with the data of one read(), by the read thread itself or
+with ReaderPipeline by the remux thread
+*/
+void cPvrReadThread::Process(uint8_t *Data, int Length)
 {
-  uint32_t pos = 0;
-  while (pos < Length) {
-    switch(pes_offset)  {
-      case 0:
-      case 1:
-        if (Data[pos] == 0x00)
-          pes_offset++;
-        else
-          pes_offset = 0;
-        pos++;
-        break;
-      case 2:
-        if (Data[pos] == 0x01)  {
-          pes_offset++;
-          pos++;
-          }
-        else
-          pes_offset = 0;
-        break;
-      case 3:
-        pes_stream_id = Data[pos];
-        pes_offset++;
-        pos++;
-        break;
-      default:
-        switch (pes_stream_id) {
-          case 0xBA:
-            switch (pes_offset) {
-              case 4:
-                pes_scr = (uint64_t)(Data[pos] & 0x38) << 27;
-                pes_scr |= (uint64_t)(Data[pos] & 3) << 28;
-                pes_offset++;
-                pos++;
-                break;
-              case 5:
-                pes_scr |= (uint64_t)(Data[pos]) << 20;
-                pes_offset++;
-                pos++;
-                break;
-              case 6:
-                pes_scr |= (uint64_t)(Data[pos] & 0xf8) << 12;
-                pes_scr |= (uint64_t)(Data[pos] & 3) << 13;
-                pes_offset++;
-                pos++;
-                break;
-              case 7:
-                pes_scr |= (uint64_t)(Data[pos]) << 5;
-                pes_offset++;
-                pos++;
-                break;
-              case 8:
-                pes_scr |= (uint64_t)(Data[pos] & 0xf8) >> 3;
-                pes_scr_ext = (uint64_t)(Data[pos] & 3) << 7;
-                pes_offset++;
-                pos++;
-                break;
-              case 9:
-                pes_scr_ext |= (Data[pos] & 0xfe) >> 1;
-                pes_scr_isvalid = true;
-                pes_offset++;
-                pos++;
-                break;
-              case 10 ... 12:
-                pes_offset++;
-                pos++;
-                break;
-              case 13:
-                pes_tmp = Data[pos] & 7;
-                pes_offset++;
-                pos++;
-                break;
-              default:
-                if (pes_tmp > 0) {
-                  pes_tmp--;
-                  pos++;
-                  }
-                else
-                  pes_offset = 0;
-                break;
-              }
-            break;
-          case 0xBB:
-            switch (pes_offset) {
-              case 4 ... 11:
-                pes_offset++;
-                pos++;
-                break;
-              default:
-                if (pes_tmp > 0) {
-                  pes_tmp--;
-                  pos++;
-                  }
-                else
-                  if (Data[pos] & 0x80) {
-                    pes_tmp = 3;
-                    }
-                  else {
-                    pes_offset = 0;
-                    }
-                break;
-              } // end: switch (pes_offset)
-            break; // end: case 0xBB
-          case 0xBD ... 0xEF:
-            switch (pes_offset) {
-              case 4:
-                pes_length = Data[pos] << 8;
-                pes_offset++;
-                pos++;
-                break;
-              case 5:
-                pes_length += Data[pos];
-                pes_buffer[0] = 0x00;
-                pes_buffer[1] = 0x00;
-                pes_buffer[2] = 0x01;
-                pes_buffer[3] = pes_stream_id;
-                pes_buffer[4] = pes_length >> 8;
-                pes_buffer[5] = pes_length & 0xFF;
-                pes_length += 6;
-                pes_offset++;
-                pos++;
-                break;
-              default: {
-                uint32_t rest = pes_length - pes_offset;
-                if (pos + rest <= Length) {
-                  memcpy(pes_buffer + pes_offset, Data + pos, rest);
-                  pos += rest;
-                  PesToTs(pes_buffer, pes_length);
-                  pes_offset = 0;
-                  }
-                else {
-                  memcpy(pes_buffer + pes_offset, Data + pos, Length - pos);
-                  pes_offset += Length - pos;
-                  pos += Length - pos;
-                  }
-                }
-                break;
-              }
-            break;
-          default:
-            // unexpected PES Stream id, most probably garbage data.
-            pes_offset = 0;
-            return;
-            break;
-          } // end: switch (pes_stream_id)
-        } // end: switch(pes_offset)
-    }  // end: while (pos < Length)
+  if (__atomic_load_n(&parent->gopAlign, __ATOMIC_ACQUIRE) && __atomic_exchange_n(&parent->gopAlign, false, __ATOMIC_ACQ_REL)) {
+     // a zap: radio has no video, the raw TS of a TS card isn't packet aligned
+     if ((parent->CurrentInputType != eRadio) &&
+         ((parent->streamType != V4L2_MPEG_STREAM_TYPE_MPEG2_TS) || parent->setup.TsPassthrough))
+        gate.Close(cTimeMs::Now());
+     }
+  if (profile) {
+     if (profileTimer.Elapsed() >= (uint64_t)PvrSetup.ProfileReader * 1000)
+        ReportProfile();
+     profile->Enter(psParse);
+     }
+  if (parent->streamType == V4L2_MPEG_STREAM_TYPE_MPEG2_TS) {
+    if (parent->setup.TsPassthrough)
+      PassThroughTs(Data, Length);
+    else
+      PutTs(Data, Length);
+    }
+  else
+    ParseProgramStream(Data, Length);
+  if (profile)
+     profile->Leave();
+  governor.Check(tsBuffer->Available(), tsBuffer->Size());
+  UpdateErrors(cTimeMs::Now());
+  if (pace)
+     Pace();
 }
 
 void cPvrReadThread::Action(void)
 {
   int bufferSize = PvrSetup.ReadBufferSizeKB * 1024;
-  uint8_t *buffer = new uint8_t[bufferSize];
+  uint8_t *buffer = PvrReadBuffers.Get(bufferSize);
+  parent->readBufferSize = bufferSize;
+  bool isFile = (parent->driver == file);
+  // ReaderPipeline: the remux thread gets the buffers, not for files which are paced by the remuxer
+  int chunks = isFile ? 0 : min(PvrSetup.ReaderPipeline, (int)cPvrChunkQueue::kCapacity);
+  cPvrRemuxThread *remuxThread = NULL;
+  int maxDepth = 0;
+  int stalls = 0;
+  uint64_t stallMs = 0;
+  if (chunks > 1) {
+     chunkBuffers[0] = buffer;
+     for (int i = 1; i < chunks; i++)
+         chunkBuffers[i] = PvrReadBuffers.Get(bufferSize);
+     for (int i = 1; i < chunks; i++) {
+         tPvrChunk chunk = { chunkBuffers[i], 0 };
+         empty.Push(chunk);
+         }
+     parent->readBufferSize = chunks * bufferSize;
+     }
+  else
+     chunks = 0;
+  bool adaptive = !isFile && (PvrSetup.CaptureMode > 0);
+  rs_latency = adaptive && parent->liveView && (parent->Priority() < 0);
+  rs_size = rs_latency ? min(PvrSetup.ReadSizeMinKB * 1024, bufferSize) : bufferSize;
+  rs_byteRate = 0;
+  rs_bytes = 0;
+  rs_timer.Set();
+  uint64_t syscalls = 0;
+  uint64_t bytes = 0;
   int r;
-  int retries = 3;
-  int reopen_retries = 5;
+  bool failed = false;
   struct timeval selTimeout;
   fd_set selSet;
 
@@ -646,92 +583,175 @@ void cPvrReadThread::Action(void)
   // A derived cThread class must check Running()
   // repeatedly to see whether it's time to stop.
   // see VDR/thread.h
-  packet_counter = 0;
-  // prepare PAT and PMT
-  if (parent->streamType != V4L2_MPEG_STREAM_TYPE_MPEG2_TS) {
-    memcpy(pat_buffer, kPAT, TS_SIZE);
-    int sid = parent->CurrentChannel.Sid();
-    int tid = parent->CurrentChannel.Tid();
-    pat_buffer[8] = (tid >> 8) & 0xFF;
-    pat_buffer[9] = tid & 0xFF;
-    pat_buffer[13] = (sid >> 8) & 0xFF;
-    pat_buffer[14] = sid & 0xFF;
-    int crc = cPvrCRC32::crc32((const char*)(pat_buffer + 5), 12, 0xFFFFFFFF);
-    pat_buffer[17] = crc >> 24;
-    pat_buffer[18] = crc >> 16;
-    pat_buffer[19] = crc >> 8;
-    pat_buffer[20] = crc;
-
-    int crc_offset = 0;
-    if (parent->CurrentInputType == eRadio) {
-      memcpy(pmt_buffer, kPMTRadio, TS_SIZE);
-      crc_offset = 28;
-      }
-    else if ((PvrSetup.SliceVBI != 0) && (cPvrDevice::VBIDeviceCount > 0)) {
-      memcpy(pmt_buffer, kPMTwithTeletext, TS_SIZE);
-      crc_offset = 40;
-      }
-    else {
-      memcpy(pmt_buffer, kPMTwithoutTeletext, TS_SIZE);
-      crc_offset = 33;
-      }
-    pmt_buffer[8] = (sid >> 8) & 0xFF;
-    pmt_buffer[9] = sid & 0xFF;
-    crc = cPvrCRC32::crc32((const char*)(pmt_buffer + 5), crc_offset - 5, 0xFFFFFFFF);
-    pmt_buffer[crc_offset] = crc >> 24;
-    pmt_buffer[crc_offset + 1] = crc >> 16;
-    pmt_buffer[crc_offset + 2] = crc >> 8;
-    pmt_buffer[crc_offset + 3] = crc;
-    }
-  retry:
+  parent->drift.Reset();
+  parent->quality.Reset();
+  parent->stats.Reset();
+  pace = isFile && parent->setup.FilePacing;
+  int sniffed = 0; // bytes kept back until the stream type of a file is known
+  if (!isFile || (parent->streamType >= 0))
+    PrepareStream();
+  wd_lastData = cTimeMs::Now();
+  wd_tier = 0;
+  profile = (PvrSetup.ProfileReader > 0) ? &stageProfile : NULL; // the remuxer times PesToTs
+  // the stages of this thread, with the pipeline only the remux thread is profiled
+  cPvrStageProfile *prof = chunks ? NULL : profile;
+  stageProfile.Reset();
+  profileTimer.Set();
+  if (chunks)
+     remuxThread = new cPvrRemuxThread(this, parent->number);
   while (Running() && parent->readThreadRunning) {
+    if (!buffer) {
+       tPvrChunk chunk = { NULL, 0 };
+       if (!empty.Pop(chunk)) { // all buffers are queued
+          cTimeMs stall;
+          stalls++;
+          while (!empty.Pop(chunk) && Running() && parent->readThreadRunning)
+            cCondWait::SleepMs(1);
+          stallMs += stall.Elapsed();
+          parent->stats.Stalled(stall.Elapsed());
+          }
+       buffer = chunk.data;
+       if (!buffer)
+          break;
+       }
+    if (adaptive)
+       AdaptReadSize(bufferSize);
     selTimeout.tv_sec = 0;
     selTimeout.tv_usec = 200000;
     FD_ZERO(&selSet);
     FD_SET(parent->v4l2_fd, &selSet);
+    if (prof)
+       prof->Enter(psSelect);
     r = select(parent->v4l2_fd + 1, &selSet, 0, 0, &selTimeout);
-    if ((r == 0) && (errno == 0)) {
-       log(pvrDEBUG1, "cPvrReadThread::Action():timeout on select from /dev/video%d: %d:%s %s",
-           parent->number, errno, strerror(errno), (retries > 0) ? " - retrying" : "");
+    if (prof)
+       prof->Leave();
+    syscalls++;
+    parent->stats.Syscall();
+    if (r == 0) {
+       if (!isFile)
+          __atomic_fetch_add(&underruns, 1, __ATOMIC_RELAXED);
+       if (!chunks) // the remux thread does this while it waits
+          UpdateErrors(cTimeMs::Now());
+       dlog(pvrDEBUG1, "cPvrReadThread::Action():timeout on select from /dev/video%d", parent->number);
        }
-    else if ((r < 0) || (errno != 0)) {
-       log(pvrERROR, "cPvrReadThread::Action():error on select from /dev/video%d: %d:%s %s",
-           parent->number, errno, strerror(errno), (retries > 0) ? " - retrying" : "");
-       retries--;
-       if (retries > 0) {
-          usleep(100);
-          goto retry;
+    else if (r < 0) {
+       if (errno == EINTR)
+          continue;
+       if (errno == ENODEV) {
+          log(pvrERROR, "cPvrReadThread::Action(): /dev/video%d is gone (%d:%s), stopping",
+              parent->number, errno, strerror(errno));
+          failed = true;
+          break;
           }
-       while (reopen_retries > 0) {
-          reopen_retries--;
-          if (parent->ReOpen() > 0) {
-             retries = 3;
-             goto retry;
-             }
-          }
-       break;
+       dlog(pvrERROR, "cPvrReadThread::Action():error on select from /dev/video%d: %d:%s",
+           parent->number, errno, strerror(errno));
+       cCondWait::SleepMs(20);
        }
     else if (FD_ISSET(parent->v4l2_fd, &selSet)) {
-       r = read(parent->v4l2_fd, buffer, bufferSize);
+       if (prof)
+          prof->Enter(psRead);
+       r = read(parent->v4l2_fd, buffer + sniffed, (adaptive ? rs_size : bufferSize) - sniffed);
+       if (prof) {
+          prof->Leave();
+          if (r > 0)
+             prof->Bytes(r);
+          }
+       syscalls++;
+       parent->stats.Syscall();
+       PVR_PROBE2(read, parent->number, r);
+       if (isFile && (r == 0)) { // end of file, or no writer on the pipe
+         if (!parent->fileIsFifo && parent->setup.FileLoop) {
+            lseek(parent->v4l2_fd, 0, SEEK_SET);
+            dlog(pvrDEBUG1, "cPvrReadThread::Action(): file device %d starts again", parent->number);
+            }
+         else
+            cCondWait::SleepMs(100);
+         continue;
+         }
+       if ((r < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+         continue;
        if (r < 0) {
-         log(pvrERROR, "cPvrReadThread::Action():error reading from /dev/video%d: %d:%s %s",
-             parent->number, errno, strerror(errno), (retries > 0) ? " - retrying" : "");
-         retries--;
-         if (retries > 0) {
-            usleep(100);
-            goto retry;
+         if (errno == ENODEV) {
+            log(pvrERROR, "cPvrReadThread::Action(): /dev/video%d is gone, stopping", parent->number);
+            failed = true;
+            break;
             }
-         break;
+         dlog(pvrERROR, "cPvrReadThread::Action():error reading from /dev/video%d: %d:%s",
+             parent->number, errno, strerror(errno));
+         cCondWait::SleepMs(20);
+         }
+       if (isFile && (r > 0) && (parent->streamType < 0)) {
+         sniffed += r;
+         if (!SniffStreamType(buffer, sniffed) && (sniffed < bufferSize))
+            continue;
+         r = sniffed;
+         sniffed = 0;
          }
        if (r > 0) {
-         if (parent->streamType == V4L2_MPEG_STREAM_TYPE_MPEG2_TS)
-           PutData(buffer, r);
+         if (wd_tier)
+            Recovered();
+         wd_lastData = cTimeMs::Now();
+         parent->stats.Read(r, wd_lastData);
+         if (chunks) {
+            tPvrChunk chunk = { buffer, r };
+            filled.Push(chunk); // can't fail, there are less buffers than places
+            remuxThread->wakeup.Signal();
+            maxDepth = max(maxDepth, filled.Count());
+            buffer = NULL;
+            }
          else
-           ParseProgramStream(buffer, r);
+            Process(buffer, r);
+         bytes += r;
+         if (adaptive) {
+            rs_bytes += r;
+            // throughput mode: let the driver collect the rest of the next read
+            if (!rs_latency && rs_byteRate && (r < rs_size)) {
+               WaitForStream(min((int)((int64_t)(rs_size - r) * 1000 / rs_byteRate), PvrSetup.ThroughputReadMs));
+               syscalls++;
+               parent->stats.Syscall();
+               }
+            }
+         continue;
          }
       }
+    if (!isFile && !Watchdog()) {
+       failed = true;
+       break;
+       }
+    }
+  delete remuxThread; // drops what is still queued
+  governor.Restore();
+  parent->stats.ReaderCpu(true);
+  if (profile && stageProfile.TotalNs())
+     ReportProfile();
+  profile = NULL;
+  if (chunks) {
+     tPvrChunk chunk;
+     while (filled.Pop(chunk))
+       ;
+     while (empty.Pop(chunk))
+       ;
+     for (int i = 0; i < chunks; i++)
+         PvrReadBuffers.Put(chunkBuffers[i], bufferSize);
+     log(pvrDEBUG1, "cPvrReadThread::Action(): pipeline of /dev/video%d: %d of %d buffers queued at most, %d stalls (%d ms)",
+         parent->number, maxDepth, chunks, stalls, (int)stallMs);
+     }
+  else
+     PvrReadBuffers.Put(buffer, bufferSize);
+  if (parent->streamType != V4L2_MPEG_STREAM_TYPE_MPEG2_TS) {
+    tPvrDriftStats ds;
+    parent->drift.GetStats(ds);
+    log(pvrDEBUG1, "cPvrReadThread::Action(): /dev/video%d SCR %+d ppm, A/V offset %d ms (drift %+d ms, corrected %d ms), PTS jitter %d us",
+        parent->number, ds.scrPpm, ds.avOffsetMs, ds.avDriftMs, ds.correctionMs, ds.ptsJitterUs);
     }
-  delete [] buffer;
-  log(errno ? pvrERROR : pvrDEBUG2, "cPvrReadThread::Action() %s on /dev/video%d ",
-      errno ? "failed" : "stopped", parent->number);
+  if (bytes)
+    log(pvrDEBUG1, "cPvrReadThread::Action(): /dev/video%d needed %.1f syscalls per MB (%llu for %llu KB)",
+        parent->number, syscalls * 1048576.0 / bytes, (unsigned long long)syscalls, (unsigned long long)(bytes / 1024));
+  if (ts_null_packets || ts_skipped_bytes)
+    log(pvrDEBUG1, "cPvrReadThread::Action(): dropped %d null packets and skipped %d bytes on /dev/video%d",
+        ts_null_packets, ts_skipped_bytes, parent->number);
+  log(failed ? pvrERROR : pvrDEBUG2, "cPvrReadThread::Action() %s on /dev/video%d ",
+      failed ? "failed" : "stopped", parent->number);
+  if (failed)
+     parent->CaptureFailed(); // last, the tune thread deletes us
 }
@@ -1,31 +1,72 @@
 #ifndef _PVRINPUT_READER_H_
 #define _PVRINPUT_READER_H_
 
-class cPvrReadThread : public cThread {
+class cPvrReadThread : public cThread, private cPvrRemux {
+  friend class cPvrRemuxThread;
 private:
   cPvrDevice *parent;
   cRingBufferLinear *tsBuffer;
-  uint8_t  pat_buffer[TS_SIZE];
-  uint8_t  pmt_buffer[TS_SIZE];
-  uint8_t  ts_buffer[TS_SIZE];
-  uint8_t  video_counter;
-  uint8_t  audio_counter;
-  uint8_t  text_counter;
-  uint8_t  pcr_counter;
-  int      packet_counter;
-  uint8_t  pes_buffer[64 * 1024];
-  uint8_t  pes_stream_id;
-  uint32_t pes_offset;
-  uint32_t pes_length;
-  uint32_t pes_tmp;
-  bool     pes_scr_isvalid;
-  uint64_t pes_scr;
-  uint32_t pes_scr_ext;
+  cPvrBitrateGovernor governor;
+  // TS passthrough (cx18, HD PVR)
+  uint8_t  ts_residual[TS_SIZE]; // incomplete packet of the last read
+  int      ts_residual_len;
+  int      ts_pmt_pid;           // as found in the PAT, -1 = not yet
+  int      ts_null_packets;
+  int      ts_skipped_bytes;
+  bool     ts_pid_map_active;
+  uint16_t ts_pid_map[0x2000];
+  // file devices: real time pacing by SCR/PCR
+  bool     pace;
+  bool     pace_valid;
+  bool     pace_clock_valid;
+  uint64_t pace_clock;        // last SCR/PCR base, 90kHz
+  uint64_t pace_clock_start;
+  uint64_t pace_time_start;   // cTimeMs::Now() at pace_clock_start
 
-  void ParseProgramStream(uint8_t *Data, uint32_t Length);
-  void PesToTs(uint8_t *Data, uint32_t Length);
   int  PutData(const unsigned char *Data, int Count);
+  void ParsePidMap(const char *Map);
+  void PassThroughTs(uint8_t *Data, int Length);
+  bool NormalizeTsPacket(uint8_t *Packet);
+  uint8_t *TsSection(uint8_t *Packet, int TableId);
+  void RewritePat(uint8_t *Packet);
+  void RewritePmt(uint8_t *Packet);
+  int  MapPid(int Pid) { return ts_pid_map_active ? ts_pid_map[Pid] : Pid; }
+  void PrepareStream(void);
+  bool SniffStreamType(const uint8_t *Data, int Length);
+  void PaceClock(uint64_t Clock) { pace_clock = Clock; pace_clock_valid = true; }
+  void Pace(void);
+  // capture watchdog
+  uint64_t wd_lastData;       // cTimeMs::Now() of the last read with data, or of the last recovery step
+  uint64_t wd_incident;       // since when there is no data
+  int      wd_tier;           // recovery steps taken, 0 = no incident
+  bool Watchdog(void);
+  void Recovered(void);
+  // pvrinput.ProfileReader
+  cPvrStageProfile stageProfile;
+  cTimeMs profileTimer;
+  void ReportProfile(void);
+  // pvrinput.ReaderPipeline
+  cPvrChunkQueue filled;      // read, waiting for the remux thread
+  cPvrChunkQueue empty;       // given back by the remux thread
+  uint8_t *chunkBuffers[cPvrChunkQueue::kCapacity];
+  void Process(uint8_t *Data, int Length);
+  int underruns;              // counted by the read thread, errors belongs to the remux thread
+  void UpdateErrors(uint64_t Now);
+  // pvrinput.GopAlign
+  cPvrGopGate gate;
+  void Deliver(const uint8_t *Data, int Count);
+  // pvrinput.CaptureMode
+  bool     rs_latency;        // latency mode, else throughput mode
+  int      rs_size;           // bytes per read()
+  int      rs_byteRate;       // measured, bytes per second
+  uint64_t rs_bytes;          // read since rs_timer
+  cTimeMs  rs_timer;
+  void AdaptReadSize(int BufferSize);
+  void WaitForStream(int TimeoutMs);
 protected:
+  virtual void PutTs(const uint8_t *Data, int Count);
+  virtual void Scr(uint64_t Scr);
+  virtual void Pes(uint8_t *Data, uint32_t Length);
   virtual void Action(void);
 public:
   cPvrReadThread(cRingBufferLinear *TsBuffer, cPvrDevice *_parent);
@@ -0,0 +1,62 @@
+#ifndef _PVRINPUT_REMUX_H_
+#define _PVRINPUT_REMUX_H_
+
+/*
+errors seen in the stream, running totals since Reset(). cPvrQualityMonitor
+turns them into SignalQuality().
+*/
+struct tPvrStreamErrors {
+  int ttxBytes;   // Hamming 8/4 protected teletext bytes
+  int ttxErrors;  // which weren't a valid code word
+  int wssLines;
+  int wssErrors;  // parity errors
+  int vpsLines;
+  int vpsErrors;  // lines without data
+  int resyncs;    // garbage in the program stream, sync lost in a TS
+  int underruns;  // the encoder delivered nothing for a while
+};
+
+/*
+The PS to TS remuxer of the read thread. It doesn't depend on vdr, so it is
+also used by the benchmark (make bench). Derived classes get the TS packets
+through PutTs() and may watch the SCR and the PES packets.
+*/
+class cPvrRemux {
+protected:
+  tPvrStreamErrors errors;
+  cPvrStageProfile *profile;  // NULL = no profiling
+private:
+  uint8_t  pat_buffer[TS_SIZE];
+  uint8_t  pmt_buffer[TS_SIZE];
+  uint8_t  ts_buffer[TS_SIZE];
+  uint8_t  video_counter;
+  uint8_t  audio_counter;
+  uint8_t  text_counter;
+  uint8_t  pcr_counter;
+  int      packet_counter;
+  uint8_t  pes_stream_id;
+  uint32_t pes_offset;
+  uint32_t pes_length;
+  uint32_t pes_tmp;
+  bool     pes_scr_isvalid;
+  uint64_t pes_scr;
+  uint32_t pes_scr_ext;
+  bool     radio;
+  uint8_t  pes_buffer[6 + 0xFFFF]; // PES header + largest PES_packet_length, pes_length can't exceed it
+  void PesToTs(uint8_t *Data, uint32_t Length);
+protected:
+  virtual void PutTs(const uint8_t *Data, int Count) = 0;
+  virtual void Scr(uint64_t Scr) {}
+  virtual void Pes(uint8_t *Data, uint32_t Length) {}
+public:
+  cPvrRemux(void);
+  virtual ~cPvrRemux() {}
+  void Reset(int Sid, int Tid, bool Radio, bool Teletext);
+  void ParseProgramStream(const uint8_t *Data, uint32_t Length);
+  const tPvrStreamErrors &Errors(void) const { return errors; }
+  static uint32_t Crc32(const uint8_t *Data, int Length);
+  static int PmtPid(void);
+  static int VideoPid(void);
+};
+
+#endif
@@ -1,7 +1,71 @@
 #include "common.h"
 
+/* all v4l2 controls of cPvrSetup, each device has its own ranges for them */
+static valSet cPvrSetup::* const ValSets[] = {
+  &cPvrSetup::Brightness, &cPvrSetup::Contrast, &cPvrSetup::Saturation, &cPvrSetup::Hue,
+  &cPvrSetup::AudioVolumeTVCommon, &cPvrSetup::AudioVolumeTVException, &cPvrSetup::AudioVolumeFM,
+  &cPvrSetup::AudioMute, &cPvrSetup::AudioSampling, &cPvrSetup::AudioEncoding, &cPvrSetup::StreamType,
+  &cPvrSetup::VideoBitrateTV, &cPvrSetup::VideoBitratePeak, &cPvrSetup::AudioBitrate, &cPvrSetup::BitrateMode,
+  &cPvrSetup::AspectRatio, &cPvrSetup::BFrames, &cPvrSetup::GopSize, &cPvrSetup::GopClosure,
+  &cPvrSetup::FilterSpatialMode, &cPvrSetup::FilterSpatial, &cPvrSetup::FilterLumaSpatialType,
+  &cPvrSetup::FilterChromaSpatialType, &cPvrSetup::FilterTemporalMode, &cPvrSetup::FilterTemporal,
+  &cPvrSetup::FilterMedianType, &cPvrSetup::FilterLumaMedianBottom, &cPvrSetup::FilterLumaMedianTop,
+  &cPvrSetup::FilterChromaMedianBottom, &cPvrSetup::FilterChromaMedianTop, &cPvrSetup::VBIformat,
+  &cPvrSetup::HDPVR_AudioEncoding
+  };
+
+/* the settings a device takes from its own setup, only these can be set per card */
+static const char *CardSettingNames[] = {
+  "SliceVBI", "TunerAudioMode", "Brightness", "Contrast", "Saturation", "Hue",
+  "AudioVolumeTVCommon", "AudioVolumeTVException", "AudioVolumeFM", "AudioSampling",
+  "VideoBitrateTV", "AudioBitrate", "BitrateMode", "AspectRatio", "StreamType",
+  "FilterSpatialMode", "FilterSpatial", "FilterLumaSpatialType", "FilterChromaSpatialType",
+  "FilterTemporalMode", "FilterTemporal", "FilterMedianType", "FilterLumaMedianBottom",
+  "FilterLumaMedianTop", "FilterChromaMedianBottom", "FilterChromaMedianTop",
+  "TsPidMap", "TsPassthrough", "BitrateGovernor", "BitrateGovernorHigh", "BitrateGovernorLow",
+  "BitrateGovernorStep", "BitrateGovernorMin", "DriftCorrection", "DriftCorrectionMaxMs",
+  "FilePacing", "FileLoop", "HDPVR_AudioEncoding", "HDPVR_AudioInput"
+  };
+
+static cList<cPvrCardSetting> CardSettings;
+static cMutex CardSettingsMutex;
+
+cPvrEncoderProfile::cPvrEncoderProfile(void)
+{
+  Invalidate();
+}
+
+void cPvrEncoderProfile::Invalidate(void)
+{
+  VideoBitrateTV   = INVALID_VALUE;
+  VideoBitratePeak = INVALID_VALUE;
+  BitrateMode      = INVALID_VALUE;
+  GopSize          = INVALID_VALUE;
+  GopClosure       = INVALID_VALUE;
+  BFrames          = INVALID_VALUE;
+}
+
+/*
+Name without the prefix "Live" or "Recording"
+*/
+bool cPvrEncoderProfile::Parse(const char *Name, const char *Value)
+{
+  if      (!strcasecmp(Name, "VideoBitrateTV"))   VideoBitrateTV   = atoi(Value) * 1000;
+  else if (!strcasecmp(Name, "VideoBitratePeak")) VideoBitratePeak = atoi(Value) * 1000;
+  else if (!strcasecmp(Name, "BitrateMode"))      BitrateMode      = atoi(Value);
+  else if (!strcasecmp(Name, "GopSize"))          GopSize          = atoi(Value);
+  else if (!strcasecmp(Name, "GopClosure"))       GopClosure       = atoi(Value);
+  else if (!strcasecmp(Name, "BFrames"))          BFrames          = atoi(Value);
+  else return false;
+  return true;
+}
+
 cPvrSetup::cPvrSetup(void)
 {
+  for (unsigned int i = 0; i < sizeof(ValSets) / sizeof(ValSets[0]); i++) {
+      memset(&(this->*ValSets[i]), 0, sizeof(valSet));
+      (this->*ValSets[i]).value = INVALID_VALUE;
+      }
   HideMainMenuEntry              = 1;            // hide main menu entry
   UseOnlyCard                    = 8;            // Use all cards
   LogLevel                       = 2;            // errors and info messages
@@ -11,9 +75,37 @@ cPvrSetup::cPvrSetup(void)
   SliceVBI                       = 1;            // Slice VBI data into mpeg stream
   UseExternChannelSwitchScript   = 0;            // don't call externchannelswitch.sh on external inputs
   ExternChannelSwitchSleep       = 0;            // sleep x seconds after call of externchannelswitch.sh
+  ExternChannelSwitchHelper      = 0;            // call externchannelswitch.sh instead of a persistent helper
+  ExternChannelSwitchTimeout     = 5000;         // wait x ms for the helper to answer READY
   ReadBufferSizeKB               = 64;           // size of buffer for reader in KB
   TsBufferSizeMB                 = 3;            // ring buffer size in MB
   TsBufferPrefillRatio           = 0;            // wait with delivering packets to vdr till buffer is filled
+  TsBufferIdleRelease            = 300;          // free the ring buffer of a device unused for x seconds
+  EncoderLingerMs                = 0;            // keep the encoder running for x ms after CloseDvr
+  PreTune                        = 0;            // idle devices encode the neighbour channels (2 = and the most watched)
+  SignalSampleMs                 = 1000;         // the tune thread samples the signal strength every x ms (0 = on each call)
+  WatchdogMs                     = 3000;         // recover the capture after x ms without data (0 = off)
+  MetricsFile[0]                 = 0;            // no metrics file
+  MetricsInterval                = 15;           // write the metrics file every x seconds
+  ProfileReader                  = 0;            // log where the read thread spends its time every x seconds (0 = off)
+  ReaderPipeline                 = 0;            // remux in a second thread with x read buffers (0 = off)
+  CaptureMode                    = 0;            // 1 = adapt the read size, latency mode for live view, throughput mode else
+  ReadSizeMinKB                  = 8;            // smallest read of CaptureMode, the largest is ReadBufferSizeKB
+  LatencyReadMs                  = 20;           // latency mode reads about x ms of stream at once
+  ThroughputReadMs               = 250;          // throughput mode collects about x ms of stream per read
+  GopAlign                       = 0;            // 1 = deliver from the first decodable picture after a zap
+  BitrateGovernor                = 0;            // don't lower the bitrate if vdr can't keep up
+  BitrateGovernorHigh            = 75;           // ring buffer fill in percent which counts as pressure
+  BitrateGovernorLow             = 25;           // ring buffer fill in percent which counts as relaxed
+  BitrateGovernorStep            = 10;           // lower the bitrate in steps of x percent
+  BitrateGovernorMin             = 50;           // but not below x percent of VideoBitrateTV
+  TsPassthrough                  = 1;            // align, drop null packets and set the SID on TS drivers
+  TsPidMap[0]                    = 0;            // no PID mapping
+  DriftCorrection                = 0;            // shift audio PTS if audio drifts against video
+  DriftCorrectionMaxMs           = 40;           // by more than x ms
+  FileDevices                    = 0;            // number of devices playing FILE= channels
+  FilePacing                     = 1;            // read files in real time, following the PCR/SCR
+  FileLoop                       = 1;            // start a file again at its end
 /*  first initialization of all v4l2 controls,
   most values will be re-initialized later one
   in QueryAllControls.  -wirbel-
@@ -51,4 +143,231 @@ cPvrSetup::cPvrSetup(void)
   HDPVR_AudioInput               = 0;
 }
 
+bool cPvrSetup::Parse(const char *Name, const char *Value)
+{
+  if      (!strncasecmp(Name, "Live", 4) && LiveProfile.Parse(Name + 4, Value)) ;
+  else if (!strncasecmp(Name, "Recording", 9) && RecordingProfile.Parse(Name + 9, Value)) ;
+  else if (!strcasecmp(Name, "LogLevel"))                     LogLevel                       = atoi(Value);
+  else if (!strcasecmp(Name, "UseOnlyCard"))                  UseOnlyCard                    = atoi(Value);
+  else if (!strcasecmp(Name, "SliceVBI"))                     SliceVBI                       = atoi(Value);
+  else if (!strcasecmp(Name, "TunerAudioMode"))               TunerAudioMode                 = atoi(Value);
+  else if (!strcasecmp(Name, "Brightness"))                   Brightness.value               = atoi(Value);
+  else if (!strcasecmp(Name, "Contrast"))                     Contrast.value                 = atoi(Value);
+  else if (!strcasecmp(Name, "Saturation"))                   Saturation.value               = atoi(Value);
+  else if (!strcasecmp(Name, "Hue"))                          Hue.value                      = atoi(Value);
+  else if (!strcasecmp(Name, "AudioVolumeTVCommon"))          AudioVolumeTVCommon.value      = atoi(Value);
+  else if (!strcasecmp(Name, "AudioVolumeTVException"))       AudioVolumeTVException.value   = atoi(Value);
+  else if (!strcasecmp(Name, "AudioVolumeTVExceptionCard"))   AudioVolumeTVExceptionCard     = atoi(Value);
+  else if (!strcasecmp(Name, "AudioVolumeFM"))                AudioVolumeFM.value            = atoi(Value);
+  else if (!strcasecmp(Name, "AudioSampling"))                AudioSampling.value            = atoi(Value);
+  else if (!strcasecmp(Name, "VideoBitrateTV"))               VideoBitrateTV.value           = atoi(Value) * 1000;
+  else if (!strcasecmp(Name, "AudioBitrate"))                 AudioBitrate.value             = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateMode"))                  BitrateMode.value              = atoi(Value);
+  else if (!strcasecmp(Name, "AspectRatio"))                  AspectRatio.value              = atoi(Value);
+  else if (!strcasecmp(Name, "StreamType"))                   StreamType.value               = atoi(Value);
+  else if (!strcasecmp(Name, "FilterSpatialMode"))            FilterSpatialMode.value        = atoi(Value);
+  else if (!strcasecmp(Name, "FilterSpatial"))                FilterSpatial.value            = atoi(Value);
+  else if (!strcasecmp(Name, "FilterLumaSpatialType"))        FilterLumaSpatialType.value    = atoi(Value);
+  else if (!strcasecmp(Name, "FilterChromaSpatialType"))      FilterChromaSpatialType.value  = atoi(Value);
+  else if (!strcasecmp(Name, "FilterTemporalMode"))           FilterTemporalMode.value       = atoi(Value);
+  else if (!strcasecmp(Name, "FilterTemporal"))               FilterTemporal.value           = atoi(Value);
+  else if (!strcasecmp(Name, "FilterMedianType"))             FilterMedianType.value         = atoi(Value);
+  else if (!strcasecmp(Name, "FilterLumaMedianBottom"))       FilterLumaMedianBottom.value   = atoi(Value);
+  else if (!strcasecmp(Name, "FilterLumaMedianTop"))          FilterLumaMedianTop.value      = atoi(Value);
+  else if (!strcasecmp(Name, "FilterChromaMedianBottom"))     FilterChromaMedianBottom.value = atoi(Value);
+  else if (!strcasecmp(Name, "FilterChromaMedianTop"))        FilterChromaMedianTop.value    = atoi(Value);
+  else if (!strcasecmp(Name, "HideMainMenuEntry"))            HideMainMenuEntry              = atoi(Value);
+  else if (!strcasecmp(Name, "ReadBufferSizeKB"))             ReadBufferSizeKB               = atoi(Value);
+  else if (!strcasecmp(Name, "TsBufferSizeMB"))               TsBufferSizeMB                 = atoi(Value);
+  else if (!strcasecmp(Name, "TsBufferPrefillRatio"))         TsBufferPrefillRatio           = atoi(Value);
+  else if (!strcasecmp(Name, "TsBufferIdleRelease"))          TsBufferIdleRelease            = atoi(Value);
+  else if (!strcasecmp(Name, "EncoderLingerMs"))              EncoderLingerMs                = atoi(Value);
+  else if (!strcasecmp(Name, "PreTune"))                      PreTune                        = atoi(Value);
+  else if (!strcasecmp(Name, "SignalSampleMs"))               SignalSampleMs                 = atoi(Value);
+  else if (!strcasecmp(Name, "WatchdogMs"))                   WatchdogMs                     = atoi(Value);
+  else if (!strcasecmp(Name, "MetricsFile"))                  strn0cpy(MetricsFile, Value, sizeof(MetricsFile));
+  else if (!strcasecmp(Name, "MetricsInterval"))              MetricsInterval                = atoi(Value);
+  else if (!strcasecmp(Name, "ProfileReader"))                ProfileReader                  = atoi(Value);
+  else if (!strcasecmp(Name, "ReaderPipeline"))               ReaderPipeline                 = atoi(Value);
+  else if (!strcasecmp(Name, "CaptureMode"))                  CaptureMode                    = atoi(Value);
+  else if (!strcasecmp(Name, "ReadSizeMinKB"))                ReadSizeMinKB                  = atoi(Value);
+  else if (!strcasecmp(Name, "LatencyReadMs"))                LatencyReadMs                  = atoi(Value);
+  else if (!strcasecmp(Name, "ThroughputReadMs"))             ThroughputReadMs               = atoi(Value);
+  else if (!strcasecmp(Name, "GopAlign"))                     GopAlign                       = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateGovernor"))              BitrateGovernor                = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateGovernorHigh"))          BitrateGovernorHigh            = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateGovernorLow"))           BitrateGovernorLow             = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateGovernorStep"))          BitrateGovernorStep            = atoi(Value);
+  else if (!strcasecmp(Name, "BitrateGovernorMin"))           BitrateGovernorMin             = atoi(Value);
+  else if (!strcasecmp(Name, "TsPassthrough"))                TsPassthrough                  = atoi(Value);
+  else if (!strcasecmp(Name, "DriftCorrection"))              DriftCorrection                = atoi(Value);
+  else if (!strcasecmp(Name, "DriftCorrectionMaxMs"))         DriftCorrectionMaxMs           = atoi(Value);
+  else if (!strcasecmp(Name, "FileDevices"))                  FileDevices                    = atoi(Value);
+  else if (!strcasecmp(Name, "FilePacing"))                   FilePacing                     = atoi(Value);
+  else if (!strcasecmp(Name, "FileLoop"))                     FileLoop                       = atoi(Value);
+  else if (!strcasecmp(Name, "TsPidMap"))                     strn0cpy(TsPidMap, Value, sizeof(TsPidMap));
+  else if (!strcasecmp(Name, "UseExternChannelSwitchScript")) UseExternChannelSwitchScript   = atoi(Value);
+  else if (!strcasecmp(Name, "ExternChannelSwitchSleep"))     ExternChannelSwitchSleep       = atoi(Value);
+  else if (!strcasecmp(Name, "ExternChannelSwitchHelper"))    ExternChannelSwitchHelper      = atoi(Value);
+  else if (!strcasecmp(Name, "ExternChannelSwitchTimeout"))   ExternChannelSwitchTimeout     = atoi(Value);
+  else if (!strcasecmp(Name, "HDPVR_AudioEncoding"))          HDPVR_AudioEncoding.value      = atoi(Value) + 3;
+  else if (!strcasecmp(Name, "HDPVR_AudioInput"))             HDPVR_AudioInput               = atoi(Value);
+  else return false;
+  return true;
+}
+
+/*
+sets all values, which are still INVALID_VALUE, to the defaults of the driver.
+The ranges have to be queried before (cPvrDevice::QueryAllControls).
+*/
+void cPvrSetup::InitValues(bool hdpvr)
+{
+  // The macro INIT(v) is a abbreviation for the 'if .. then' comparison.
+  #define INIT(v) if (v.value == INVALID_VALUE) v.value=v.queryctrl.default_value
+  // picture properties
+  INIT(Brightness);
+  INIT(Contrast);
+  INIT(Saturation);
+  INIT(Hue);
+  // Audio
+  if (AudioVolumeTVCommon.value == INVALID_VALUE)
+    AudioVolumeTVCommon.value = (int)(0.95 * AudioVolumeTVCommon.queryctrl.maximum);
+  if (AudioVolumeTVException.value == INVALID_VALUE)
+    AudioVolumeTVException.value = (int)(0.95 * AudioVolumeTVException.queryctrl.maximum);
+  if (AudioVolumeFM.value == INVALID_VALUE)
+    AudioVolumeFM.value = AudioVolumeFM.queryctrl.maximum;
+  INIT(AudioBitrate);
+  INIT(AudioSampling);
+  if (hdpvr)
+    INIT(HDPVR_AudioEncoding);
+  // Video
+  INIT(VideoBitrateTV);
+  INIT(AspectRatio);
+  // MPEG
+  INIT(BitrateMode);
+  INIT(BFrames);
+  INIT(GopSize);
+  INIT(GopClosure);
+  // Video Filters
+  INIT(FilterSpatialMode);
+  INIT(FilterSpatial);
+  INIT(FilterLumaSpatialType);
+  INIT(FilterChromaSpatialType);
+  INIT(FilterTemporalMode);
+  INIT(FilterTemporal);
+  INIT(FilterMedianType);
+  INIT(FilterLumaMedianBottom);
+  INIT(FilterLumaMedianTop);
+  INIT(FilterChromaMedianBottom);
+  INIT(FilterChromaMedianTop);
+  #undef INIT
+}
+
+/*
+copies the queried ranges of all controls, but not their values.
+With OnlyMissing only controls which aren't queried yet are taken.
+*/
+void cPvrSetup::TakeControls(const cPvrSetup &From, bool OnlyMissing)
+{
+  for (unsigned int i = 0; i < sizeof(ValSets) / sizeof(ValSets[0]); i++) {
+      valSet &to = this->*ValSets[i];
+      const valSet &from = From.*ValSets[i];
+      if (OnlyMissing && (to.query_isvalid || !from.query_isvalid))
+         continue;
+      to.queryctrl     = from.queryctrl;
+      to.ctrl_class    = from.ctrl_class;
+      to.query_isvalid = from.query_isvalid;
+      }
+}
+
+void cPvrSetup::ApplyCardSettings(const char *BusID)
+{
+  cString id = CardID(BusID);
+  cMutexLock lock(&CardSettingsMutex);
+  for (cPvrCardSetting *s = CardSettings.First(); s; s = CardSettings.Next(s)) {
+      if (!strcmp(*s->busID, *id))
+         Parse(*s->name, *s->value);
+      }
+}
+
+/*
+the settings the read thread uses without locking, they are kept while it runs
+*/
+void cPvrSetup::TakeReaderSettings(const cPvrSetup &From)
+{
+  SliceVBI             = From.SliceVBI;
+  TsPassthrough        = From.TsPassthrough;
+  BitrateGovernor      = From.BitrateGovernor;
+  BitrateGovernorHigh  = From.BitrateGovernorHigh;
+  BitrateGovernorLow   = From.BitrateGovernorLow;
+  BitrateGovernorStep  = From.BitrateGovernorStep;
+  BitrateGovernorMin   = From.BitrateGovernorMin;
+  DriftCorrection      = From.DriftCorrection;
+  DriftCorrectionMaxMs = From.DriftCorrectionMaxMs;
+  FilePacing           = From.FilePacing;
+  FileLoop             = From.FileLoop;
+  strn0cpy(TsPidMap, From.TsPidMap, sizeof(TsPidMap));
+}
+
+bool cPvrSetup::IsCardSetting(const char *Name)
+{
+  // the encoder profiles, LiveGopSize, RecordingVideoBitrateTV, ...
+  if (!strncasecmp(Name, "Live", 4) || !strncasecmp(Name, "Recording", 9))
+     return true;
+  for (unsigned int i = 0; i < sizeof(CardSettingNames) / sizeof(CardSettingNames[0]); i++) {
+      if (!strcasecmp(Name, CardSettingNames[i]))
+         return true;
+      }
+  return false;
+}
+
+cString cPvrSetup::CardID(const char *BusID)
+{
+  // setup.conf doesn't like blanks and '=' in names
+  char *id = strdup(BusID);
+  for (char *p = id; *p; p++) {
+      if ((*p <= ' ') || (*p == '='))
+         *p = '_';
+      }
+  cString result(id);
+  free(id);
+  return result;
+}
+
+cString cPvrSetup::CardSettingName(const char *BusID, const char *Name)
+{
+  return cString::sprintf("Card.%s.%s", *CardID(BusID), Name);
+}
+
+/*
+Name is Card.<BusID>.<Name>, the BusID itself may contain dots
+*/
+bool cPvrSetup::ParseCardSetting(const char *Name, const char *Value)
+{
+  if (strncasecmp(Name, "Card.", 5))
+     return false;
+  const char *busID = Name + 5;
+  const char *name = strrchr(busID, '.');
+  if (!name || (name == busID))
+     return false;
+  cString id = cString::sprintf("%.*s", (int)(name - busID), busID);
+  name++;
+  if (!IsCardSetting(name)) {
+     log(pvrERROR, "cPvrSetup: %s can't be set per card, ignoring %s", name, Name);
+     return false;
+     }
+  cPvrSetup test;
+  if (!test.Parse(name, Value))
+     return false;
+  cMutexLock lock(&CardSettingsMutex);
+  for (cPvrCardSetting *s = CardSettings.First(); s; s = CardSettings.Next(s)) {
+      if (!strcmp(*s->busID, *id) && !strcasecmp(*s->name, name)) {
+         s->value = Value;
+         return true;
+         }
+      }
+  CardSettings.Add(new cPvrCardSetting(*id, name, Value));
+  return true;
+}
+
 cPvrSetup PvrSetup;
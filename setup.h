@@ -8,6 +8,23 @@ struct valSet {
   bool query_isvalid;
 };
 
+/*
+encoder settings which depend on who holds the device. INVALID_VALUE means:
+use the common value (VideoBitrateTV, BitrateMode, ...) of cPvrSetup.
+*/
+class cPvrEncoderProfile {
+public:
+  int VideoBitrateTV;
+  int VideoBitratePeak;
+  int BitrateMode;
+  int GopSize;
+  int GopClosure;
+  int BFrames;
+  cPvrEncoderProfile(void);
+  void Invalidate(void);
+  bool Parse(const char *Name, const char *Value);
+};
+
 class cPvrSetup {
 public:
   int HideMainMenuEntry;
@@ -18,9 +35,39 @@ public:
   int AudioVolumeTVExceptionCard;
   int UseExternChannelSwitchScript;
   int ExternChannelSwitchSleep;
+  int ExternChannelSwitchHelper;
+  int ExternChannelSwitchTimeout;
   int ReadBufferSizeKB;
   int TsBufferSizeMB;
   int TsBufferPrefillRatio;
+  int TsBufferIdleRelease;
+  int EncoderLingerMs;
+  int PreTune;
+  int SignalSampleMs;
+  int WatchdogMs;
+  char MetricsFile[256];
+  int MetricsInterval;
+  int ProfileReader;
+  int ReaderPipeline;
+  int CaptureMode;
+  int ReadSizeMinKB;
+  int LatencyReadMs;
+  int ThroughputReadMs;
+  int GopAlign;
+  int BitrateGovernor;
+  int BitrateGovernorHigh;
+  int BitrateGovernorLow;
+  int BitrateGovernorStep;
+  int BitrateGovernorMin;
+  int TsPassthrough;
+  char TsPidMap[256];
+  int DriftCorrection;
+  int DriftCorrectionMaxMs;
+  int FileDevices;
+  int FilePacing;
+  int FileLoop;
+  cPvrEncoderProfile LiveProfile;
+  cPvrEncoderProfile RecordingProfile;
   valSet Brightness;
   valSet Contrast;
   valSet Saturation;
@@ -58,7 +105,30 @@ public:
 
 public:
   cPvrSetup(void);
-  bool repeat_ReInitAll_after_next_encoderstop;
+  bool Parse(const char *Name, const char *Value);
+  void InitValues(bool hdpvr);
+  void TakeControls(const cPvrSetup &From, bool OnlyMissing);
+  void ApplyCardSettings(const char *BusID);
+  void TakeReaderSettings(const cPvrSetup &From);
+  static bool ParseCardSetting(const char *Name, const char *Value);
+  static cString CardSettingName(const char *BusID, const char *Name);
+private:
+  static cString CardID(const char *BusID);
+  static bool IsCardSetting(const char *Name);
+};
+
+/*
+settings for a single card, stored in setup.conf as
+pvrinput.Card.<BusID>.<Name>. They override the common value of <Name>
+for the device with this BusID.
+*/
+class cPvrCardSetting : public cListObject {
+public:
+  cString busID;
+  cString name;
+  cString value;
+  cPvrCardSetting(const char *BusID, const char *Name, const char *Value)
+  : busID(BusID), name(Name), value(Value) {}
 };
 
 extern cPvrSetup PvrSetup;
@@ -18,7 +18,8 @@ const char *cPvrSourceParam::sInputName[] = {
  "SVIDEO1",
  "SVIDEO2",
  "SVIDEO3",
- "COMPONENT"
+ "COMPONENT",
+ "FILE"
 };
 
 const eInputType cPvrSourceParam::sInputType[] = {
@@ -33,7 +34,8 @@ const eInputType cPvrSourceParam::sInputType[] = {
  eSVideo1,
  eSVideo2,
  eSVideo3,
- eComponent
+ eComponent,
+ eFile
 };
 
 const char *cPvrSourceParam::sCards[] = {
@@ -163,6 +165,8 @@ cPvrSourceParam::cPvrSourceParam()
 
 cString cPvrSourceParam::ParametersToString(void) const
 {
+  if (sInputType[input] == eFile)
+     return cString::sprintf("%sFILE=%s", sPluginId, *fileName ? *fileName : "");
   if ((standard == 0) && (card == 0))
      return cString::sprintf("%s%s", sPluginId, sInputName[input]);
   if ((standard == 0) && (card != 0))
@@ -175,7 +179,7 @@ cString cPvrSourceParam::ParametersToString(void) const
 void cPvrSourceParam::SetData(cChannel *Channel)
 {
 #ifdef PVR_SOURCEPARAMS
-  ParseParameters(Channel->Parameters(), &input, &standard, &card);
+  ParseParameters(Channel->Parameters(), &input, &standard, &card, &fileName);
 #endif
   param = 0;
 }
@@ -203,7 +207,23 @@ bool cPvrSourceParam::IsPvr(int Code)
   return (Code & cSource::st_Mask) == stPvr;
 }
 
-bool    cPvrSourceParam::ParseParameters(const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex)
+/*
+returns the path of a FILE=<path> channel, NULL for all other channels
+*/
+cString cPvrSourceParam::FileName(const cChannel *Channel)
+{
+  cString fileName;
+#ifdef PVR_SOURCEPARAMS
+  const char *str = Channel->Parameters();
+#else
+  const char *str = Channel->PluginParam();
+#endif
+  if (str)
+     ParseParameters(str, NULL, NULL, NULL, &fileName);
+  return fileName;
+}
+
+bool    cPvrSourceParam::ParseParameters(const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex, cString *FileName)
 {
   char *InputArg  = NULL;
   char *OptArg[2] = { NULL, NULL };
@@ -212,9 +232,23 @@ bool    cPvrSourceParam::ParseParameters(const char *Parameters, int *InputIndex
 #else
   char *PluginId  = NULL;
   sscanf(Parameters, "%m[^|]|%m[^|]|%m[^|]|%m[^:\n]", &PluginId, &InputArg, &OptArg[0], &OptArg[1]);
-  if (strcasecmp(PluginId, "PVRINPUT"))
+  bool isPvr = PluginId && !strcasecmp(PluginId, "PVRINPUT");
+  free(PluginId);
+  if (!isPvr) {
+     free(InputArg);
+     free(OptArg[0]);
+     free(OptArg[1]);
      return false;
+     }
 #endif
+  if (FileName)
+     *FileName = cString(NULL);
+  if ((InputArg != NULL) && !strncasecmp(InputArg, "FILE=", 5)) {
+     // the path may not contain '|' or ':'
+     if (FileName)
+        *FileName = cString(InputArg + 5);
+     InputArg[4] = 0;
+     }
   if (InputIndex) {
      *InputIndex = 0;
      if (InputArg != NULL) {
@@ -252,6 +286,69 @@ bool    cPvrSourceParam::ParseParameters(const char *Parameters, int *InputIndex
             }
          }
       }
+  free(InputArg);
+  free(OptArg[0]);
+  free(OptArg[1]);
   return true;
 }
 
+/*
+ProvidesChannel is called for every device on every channel lookup, so the
+result of ParseParameters is kept per channel. An entry is only used if the
+channel id and a hash of the parameter string still match, FlushCache()
+empties the cache when vdr changed its channels.
+*/
+cPvrSourceParam::tParseCacheEntry cPvrSourceParam::parseCache[kParseCacheSize];
+cMutex cPvrSourceParam::parseCacheMutex;
+int cPvrSourceParam::parseCacheHits = 0;
+int cPvrSourceParam::parseCacheMisses = 0;
+
+bool cPvrSourceParam::ParseChannel(const cChannel *Channel, const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex)
+{
+  uint32_t hash = 2166136261u; // FNV-1a
+  for (const char *p = Parameters; *p; p++)
+      hash = (hash ^ (uint8_t)*p) * 16777619u;
+  tChannelID id = Channel->GetChannelID();
+  tParseCacheEntry *e = &parseCache[(hash ^ (Channel->Sid() * 2654435761u) ^ Channel->Frequency()) % kParseCacheSize];
+  cMutexLock lock(&parseCacheMutex);
+  if (e->valid && (e->hash == hash) && (e->id == id)) {
+     parseCacheHits++;
+     }
+  else {
+     parseCacheMisses++;
+     e->valid = true;
+     e->id = id;
+     e->hash = hash;
+     e->ok = ParseParameters(Parameters, &e->input, &e->standard, &e->card);
+     log(pvrDEBUG2, "cPvrSourceParam::ParseChannel: %s -> %s input %d, standard %d, card %d",
+         Parameters, e->ok ? "ok" : "not pvrinput", e->input, e->standard, e->card);
+     }
+  *InputIndex = e->input;
+  *StandardIndex = e->standard;
+  *CardIndex = e->card;
+  return e->ok;
+}
+
+void cPvrSourceParam::FlushCache(void)
+{
+  cMutexLock lock(&parseCacheMutex);
+  for (int i = 0; i < kParseCacheSize; i++)
+      parseCache[i].valid = false;
+  log(pvrDEBUG2, "cPvrSourceParam::FlushCache: %d hits, %d misses", parseCacheHits, parseCacheMisses);
+  parseCacheHits = parseCacheMisses = 0;
+}
+
+/*
+called from Housekeeping: drop the cached results after the channels changed
+*/
+void cPvrSourceParam::CheckChannels(void)
+{
+#if VDRVERSNUM > 20300
+  static cStateKey StateKey;
+  if (cChannels::GetChannelsRead(StateKey)) {
+     StateKey.Remove();
+     FlushCache();
+     }
+#endif
+}
+
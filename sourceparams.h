@@ -11,6 +11,21 @@ private:
   int input;
   int standard;
   int card;
+  cString fileName;
+  enum { kParseCacheSize = 1024 };
+  struct tParseCacheEntry {
+    bool valid;
+    bool ok;
+    tChannelID id;
+    uint32_t hash;
+    int input;
+    int standard;
+    int card;
+  };
+  static tParseCacheEntry parseCache[kParseCacheSize];
+  static cMutex parseCacheMutex;
+  static int parseCacheHits;
+  static int parseCacheMisses;
 
 public:
   cPvrSourceParam();
@@ -20,7 +35,11 @@ public:
   virtual cOsdItem *GetOsdItem(void);
 
   static bool IsPvr(int Code);
-  static bool ParseParameters(const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex);
+  static bool ParseParameters(const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex, cString *FileName = NULL);
+  static cString FileName(const cChannel *Channel);
+  static bool ParseChannel(const cChannel *Channel, const char *Parameters, int *InputIndex, int *StandardIndex, int *CardIndex);
+  static void FlushCache(void);
+  static void CheckChannels(void);
 
 #ifdef PVR_SOURCEPARAMS
   static const char *sPluginId;
@@ -32,7 +51,7 @@ public:
   static const uint  stPvr = cSource::stPlug;
 #endif
 
-  static const int         sNumInputs = 12;
+  static const int         sNumInputs = 13;
   static const char       *sInputName[];
   static const eInputType  sInputType[];
 
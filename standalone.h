@@ -0,0 +1,26 @@
+#ifndef _PVRINPUT_STANDALONE_H_
+#define _PVRINPUT_STANDALONE_H_
+
+/*
+the little of common.h and vdr the remuxer needs, for tools built without vdr
+*/
+#include <linux/videodev2.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+enum eLogLevel { pvrUNUSED, pvrERROR, pvrINFO, pvrDEBUG1, pvrDEBUG2, pvrDEBUG3 };
+
+#define TS_SIZE      188
+#define TS_SYNC_BYTE 0x47
+
+extern int PvrStandaloneLogLevel;
+void log(int level, const char *fmt, ...);
+#define dlog(level, ...) do { if (PvrStandaloneLogLevel >= (level)) log(level, __VA_ARGS__); } while (0)
+
+#include <time.h>
+#include "probes.h"
+#include "profile.h"
+#include "remux.h"
+
+#endif
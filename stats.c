@@ -0,0 +1,117 @@
+#include "common.h"
+#include <time.h>
+
+const int cPvrStreamStats::kZapBucketMs[tPvrTotals::kZapBuckets - 1] = { 100, 250, 500, 1000, 2000, 5000 };
+
+cPvrStreamStats::cPvrStreamStats(void)
+{
+  memset(&totals, 0, sizeof(totals));
+  cpuFinished = 0;
+  cpuRunning[kReadThread] = cpuRunning[kRemuxThread] = 0;
+  Reset();
+}
+
+void cPvrStreamStats::Reset(void)
+{
+  memset(bytes, 0, sizeof(bytes));
+  second = 0;
+  overflows = resyncs = timeouts = 0;
+}
+
+/*
+starts the slot of a new second, the slots of seconds without any read are
+cleared on the way
+*/
+void cPvrStreamStats::Advance(uint64_t Second)
+{
+  if (Second <= second)
+     return;
+  uint64_t from = (Second - second > kSeconds) ? Second - kSeconds : second;
+  for (uint64_t s = from + 1; s <= Second; s++)
+      bytes[s % kSeconds] = 0;
+  second = Second;
+}
+
+void cPvrStreamStats::Read(int Bytes, uint64_t NowMs)
+{
+  uint64_t s = NowMs / 1000;
+  if (s != second) {
+     Advance(s);
+     ReaderCpu(false);
+     }
+  bytes[second % kSeconds] += Bytes;
+  Add(totals.bytesRead, Bytes);
+}
+
+void cPvrStreamStats::Zap(int Ms)
+{
+  int b = 0;
+  while ((b < tPvrTotals::kZapBuckets - 1) && (Ms > kZapBucketMs[b]))
+    b++;
+  Add(totals.zapBuckets[b], 1);
+  Add(totals.zapSumMs, Ms);
+  Add(totals.zapCount, 1);
+}
+
+/*
+called by the read thread and the remux thread of ReaderPipeline about once
+a second and when they end
+*/
+void cPvrStreamStats::ReaderCpu(bool Finished, eCpuThread Thread)
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+     return;
+  uint64_t ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  if (Finished) {
+     Add(cpuFinished, ns);
+     ns = 0;
+     }
+  __atomic_store_n(&cpuRunning[Thread], ns, __ATOMIC_RELAXED);
+}
+
+void cPvrStreamStats::GetTotals(tPvrTotals &Totals) const
+{
+  Totals.bytesRead     = __atomic_load_n(&totals.bytesRead, __ATOMIC_RELAXED);
+  Totals.bytesPut      = __atomic_load_n(&totals.bytesPut, __ATOMIC_RELAXED);
+  Totals.overflowBytes = __atomic_load_n(&totals.overflowBytes, __ATOMIC_RELAXED);
+  Totals.syncSkipBytes = __atomic_load_n(&totals.syncSkipBytes, __ATOMIC_RELAXED);
+  Totals.readerCpuNs   = __atomic_load_n(&cpuFinished, __ATOMIC_RELAXED) +
+                         __atomic_load_n(&cpuRunning[kReadThread], __ATOMIC_RELAXED) +
+                         __atomic_load_n(&cpuRunning[kRemuxThread], __ATOMIC_RELAXED);
+  Totals.stallMs       = __atomic_load_n(&totals.stallMs, __ATOMIC_RELAXED);
+  Totals.syscalls      = __atomic_load_n(&totals.syscalls, __ATOMIC_RELAXED);
+  Totals.zapCount      = __atomic_load_n(&totals.zapCount, __ATOMIC_RELAXED);
+  Totals.zapSumMs      = __atomic_load_n(&totals.zapSumMs, __ATOMIC_RELAXED);
+  for (int i = 0; i < tPvrTotals::kZapBuckets; i++)
+      Totals.zapBuckets[i] = __atomic_load_n(&totals.zapBuckets[i], __ATOMIC_RELAXED);
+}
+
+void cPvrStreamStats::Errors(const tPvrStreamErrors &Errors)
+{
+  resyncs = Errors.resyncs;
+  timeouts = Errors.underruns;
+}
+
+/*
+called from the menu. The slot of the current second is still being filled,
+so the bitrate is the one of the second before.
+*/
+void cPvrStreamStats::Get(tPvrStats &Stats, uint64_t NowMs) const
+{
+  uint64_t now = NowMs / 1000;
+  uint64_t last = second;
+  int peak = 0;
+  for (int i = 0; i < kSeconds; i++) {
+      uint64_t s = now - i;
+      if ((s > last) || (last - s >= kSeconds))
+         continue; // nothing read in this second, or the slot is older
+      if ((s != now) && (bytes[s % kSeconds] > peak))
+         peak = bytes[s % kSeconds];
+      }
+  Stats.kbps = ((now >= 1) && (now - 1 <= last) && (last - (now - 1) < kSeconds)) ? bytes[(now - 1) % kSeconds] / 125 : 0;
+  Stats.peakKbps = peak / 125;
+  Stats.overflows = overflows;
+  Stats.resyncs = resyncs;
+  Stats.timeouts = timeouts;
+}
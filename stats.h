@@ -0,0 +1,72 @@
+#ifndef _PVRINPUT_STATS_H_
+#define _PVRINPUT_STATS_H_
+
+struct tPvrStats {
+  bool active;        // the read thread is running
+  int kbps;           // bitrate of the last full second
+  int peakKbps;       // highest of the last 60 seconds
+  int bufferFill;     // ring buffer fill in percent
+  int prefill;        // percent still to be filled before delivery starts, 0 = delivering
+  int overflows;      // TS packets dropped because the ring buffer was full
+  int resyncs;
+  int timeouts;       // select timeouts
+  int lastZapMs;      // SetChannelDevice to the first packet for vdr, -1 = none yet
+  int signal;         // percent, -1 = unknown
+  int bufferMemory;   // bytes of ring buffer and read buffer the device holds, see BufferMemory()
+  tPvrDriftStats drift; // program streams only
+};
+
+/*
+counters since the start of vdr for the metrics file, never reset
+*/
+struct tPvrTotals {
+  enum { kZapBuckets = 7 };
+  uint64_t bytesRead;
+  uint64_t bytesPut;        // TS packets for vdr, in bytes
+  uint64_t overflowBytes;
+  uint64_t syncSkipBytes;   // skipped to find a TS sync byte
+  uint64_t readerCpuNs;     // CPU time of the read and remux threads
+  uint64_t stallMs;         // ReaderPipeline: read thread waited for a free buffer
+  uint64_t syscalls;        // select, read and poll of the read thread
+  uint64_t zapCount;
+  uint64_t zapSumMs;
+  uint64_t zapBuckets[kZapBuckets]; // not cumulative, see kZapBucketMs
+};
+
+/*
+Counters for the statistics page of the plugin menu. Only the read thread
+writes them, the menu reads them once a second. The totals are also written
+by GetTSPacket.
+*/
+class cPvrStreamStats {
+private:
+  enum { kSeconds = 60 };
+  int bytes[kSeconds];   // bytes read per second, index = second % kSeconds
+  uint64_t second;       // the second bytes[] is filled for
+  int overflows;
+  int resyncs;
+  int timeouts;
+  tPvrTotals totals;
+  uint64_t cpuFinished;  // CPU time of the read and remux threads which ended
+  uint64_t cpuRunning[2]; // of the running ones, see eCpuThread
+  void Advance(uint64_t Second);
+  static void Add(uint64_t &Counter, uint64_t Value) { __atomic_fetch_add(&Counter, Value, __ATOMIC_RELAXED); }
+public:
+  enum eCpuThread { kReadThread, kRemuxThread };
+  cPvrStreamStats(void);
+  void Reset(void);
+  void Read(int Bytes, uint64_t NowMs);
+  void Overflow(int Bytes) { overflows += Bytes / TS_SIZE; Add(totals.overflowBytes, Bytes); }
+  void Put(int Bytes) { Add(totals.bytesPut, Bytes); }
+  void SyncSkipped(int Bytes) { Add(totals.syncSkipBytes, Bytes); }
+  void Stalled(uint64_t Ms) { Add(totals.stallMs, Ms); }
+  void Syscall(void) { Add(totals.syscalls, 1); }
+  void Zap(int Ms);
+  void ReaderCpu(bool Finished, eCpuThread Thread = kReadThread);
+  void Errors(const tPvrStreamErrors &Errors);
+  void Get(tPvrStats &Stats, uint64_t NowMs) const;
+  void GetTotals(tPvrTotals &Totals) const;
+  static const int kZapBucketMs[tPvrTotals::kZapBuckets - 1]; // upper bounds, the last bucket is +Inf
+};
+
+#endif
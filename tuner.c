@@ -0,0 +1,153 @@
+#include "common.h"
+
+cPvrTuneThread::cPvrTuneThread(cPvrDevice *_parent)
+: parent(_parent),
+  active(true)
+{
+  log(pvrDEBUG1, "cPvrTuneThread");
+  SetDescription("PvrTuneThread of /dev/video%d", _parent->number);
+  Start();
+}
+
+cPvrTuneThread::~cPvrTuneThread(void)
+{
+  log(pvrDEBUG2, "~cPvrTuneThread");
+  parent->stateMutex.Lock();
+  active = false;
+  parent->stateCond.Broadcast();
+  parent->stateMutex.Unlock();
+  if (Running())
+     Cancel(3);
+}
+
+void cPvrTuneThread::Action(void)
+{
+  log(pvrDEBUG1, "cPvrTuneThread::Action(): Entering Action() on /dev/video%d", parent->number);
+  parent->stateMutex.Lock();
+  while (Running() && active) {
+    /* the watchdog of the read thread wants a recovery step, or gave up */
+    if (parent->recoveryRequest) {
+       parent->Recover();
+       continue;
+       }
+    if (parent->captureFailed && parent->readThread) {
+       parent->TearDownFailed();
+       continue;
+       }
+    /* a step of the bitrate governor of the read thread */
+    if ((parent->bitrateLevelWanted >= 0) && (parent->bitrateLevel != parent->bitrateLevelWanted)) {
+       int level = parent->bitrateLevelWanted;
+       parent->stateMutex.Unlock();
+       bool ok = parent->ApplyBitrateLevel(level);
+       parent->stateMutex.Lock();
+       if (ok)
+          parent->bitrateLevel = level; // compared with bitrateLevelWanted again
+       else
+          parent->bitrateLevel = parent->bitrateLevelWanted = -1; // until the next StartEncoder
+       continue;
+       }
+    /* not while the fd is reopened, the next sample is taken when it's done */
+    if ((SignalDue() == 0) && !parent->fdChanges) {
+       parent->signalForce = false;
+       parent->stateMutex.Unlock();
+       int strength;
+       if (parent->ReadSignalStrength(strength))
+          __atomic_store_n(&parent->signalStrength, strength, __ATOMIC_RELEASE);
+       parent->signalNextSample = cTimeMs::Now() + max(PvrSetup.SignalSampleMs, 100);
+       parent->stateMutex.Lock();
+       continue;
+       }
+    /* PreTune chose a channel for this idle device */
+    if (parent->preTunePending) {
+       parent->StartPreTune();
+       continue;
+       }
+    /* CloseDvr left the encoder running: stop it when the time is over or
+       another channel is wanted */
+    if (parent->lingering) {
+       int remaining = (int)(parent->lingerUntil - cTimeMs::Now());
+       if ((parent->tuneState == eTunePending) || (!parent->preTuned && (remaining <= 0))) {
+          parent->stateMutex.Unlock();
+          parent->EndLinger();
+          parent->stateMutex.Lock();
+          }
+       else if (parent->preTuned) // until vdr or PreTune wants something else
+          WaitState(0);
+       else
+          WaitState(remaining);
+       continue;
+       }
+    /* nothing to do, or the encoder of the previous channel is still
+       running. SetChannelDevice, CloseDvr and SetEncoderState signal us. */
+    if ((parent->tuneState != eTunePending) || parent->dvrOpen || !parent->pvrusb2_ready) {
+       WaitState(0);
+       continue;
+       }
+    int generation         = parent->tuneGeneration;
+    cChannel channel       = parent->CurrentChannel;
+    eInputType inputType   = parent->newInputType;
+    int input              = parent->newInput;
+    uint64_t norm          = parent->newNorm;
+    int frequency          = parent->newFrequency;
+    bool preTune           = parent->preTuneRequested;
+    parent->preTuneRequested = false;
+    parent->tuneState = eTuneSwitching;
+    parent->stateMutex.Unlock();
+
+    cTimeMs duration;
+    bool ok = parent->SwitchToChannel(channel, inputType, input, norm, frequency);
+    log(ok ? pvrDEBUG1 : pvrERROR, "cPvrTuneThread::Action(): switch to %d (%s) on /dev/video%d %s after %d ms",
+        channel.Number(), channel.Name(), parent->number, ok ? "done" : "failed", (int)duration.Elapsed());
+
+    if (ok && preTune) { // OpenDvr waits while we are eTuneSwitching
+       parent->CurrentInputType = inputType;
+       parent->StartPreTuned();
+       }
+
+    parent->stateMutex.Lock();
+    if (generation == parent->tuneGeneration) {
+       if (ok)
+          parent->CurrentInputType = inputType;
+       parent->ChannelSettingsDone = ok;
+       parent->signalForce = ok;
+       parent->tuneState = ok ? eTuneDone : eTuneFailed;
+       parent->stateCond.Broadcast();
+       }
+    // else SetChannelDevice was called meanwhile and tuneState is eTunePending again
+    }
+  parent->stateMutex.Unlock();
+  log(pvrDEBUG2, "cPvrTuneThread::Action() stopped on /dev/video%d", parent->number);
+}
+
+/*
+ms until the signal strength should be sampled again, -1 if nobody asked for
+it recently. Called with stateMutex locked.
+*/
+int cPvrTuneThread::SignalDue(void)
+{
+  if ((PvrSetup.SignalSampleMs <= 0) || (parent->driver == file))
+     return -1;
+  uint64_t now = cTimeMs::Now();
+  if (parent->signalForce)
+     return 0;
+  if (now - __atomic_load_n(&parent->signalLastRequest, __ATOMIC_ACQUIRE) > (uint64_t)cPvrDevice::kSignalIdleMs)
+     return -1;
+  if (parent->signalNextSample <= now)
+     return 0;
+  return (int)(parent->signalNextSample - now);
+}
+
+/*
+waits on stateCond for at most TimeoutMs (0 = no limit), but not longer than
+until the next signal sample is due
+*/
+void cPvrTuneThread::WaitState(int TimeoutMs)
+{
+  int due = SignalDue();
+  if ((due > 0) && ((TimeoutMs <= 0) || (due < TimeoutMs)))
+     TimeoutMs = due;
+  if (TimeoutMs > 0)
+     parent->stateCond.TimedWait(parent->stateMutex, TimeoutMs);
+  else
+     parent->stateCond.Wait(parent->stateMutex);
+}
@@ -0,0 +1,25 @@
+#ifndef _PVRINPUT_TUNER_H_
+#define _PVRINPUT_TUNER_H_
+
+/*
+The tune thread does the hardware part of a channel switch (input, norm,
+frequency, radio device, externchannelswitch.sh). It is woken up by
+SetChannelDevice, so tuning runs while vdr is still setting up its
+receivers. OpenDvr only waits for the switch to finish. It also stops an
+encoder left running by CloseDvr (EncoderLingerMs) and samples the signal
+strength for SignalStrength().
+*/
+class cPvrTuneThread : public cThread {
+private:
+  cPvrDevice *parent;
+  bool active;
+  int SignalDue(void);
+  void WaitState(int TimeoutMs);
+protected:
+  virtual void Action(void);
+public:
+  cPvrTuneThread(cPvrDevice *_parent);
+  virtual ~cPvrTuneThread(void);
+};
+
+#endif